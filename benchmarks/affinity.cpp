@@ -0,0 +1,75 @@
+#include "affinity.hpp"
+#include "bench.hpp"
+#include <atomic>
+#include <thread>
+
+#define NB_FRAMES 250
+
+static std::string clip(int i)
+{
+	return fmt::format("/tmp/affinity_bench_{}.mkv", i);
+}
+
+/*
+ * every stream demuxed and decoded by its own thread, opened after the
+ * thread is placed
+ */
+static void run(const std::string &name, size_t nb_streams, bool pinned)
+{
+	av::placement placement(nb_streams, pinned);
+	std::vector<std::thread> threads;
+	std::atomic<int> frames(0);
+	stopwatch sw;
+
+	for (size_t i = 0; i < nb_streams; i++) {
+		threads.emplace_back([&, i]() {
+			av::input in;
+			av::packet p;
+			av::frame f;
+
+			placement.pin(i);
+
+			if (!in.open(clip(i)))
+				return;
+
+			av::decoder dec =
+			    in.get(0, "", placement.codec_options(i));
+			if (!dec)
+				return;
+
+			while (in >> p) {
+				dec << p;
+				while (dec >> f)
+					frames++;
+			}
+
+			dec.flush();
+			while (dec >> f)
+				frames++;
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	fmt::print("{:9}: {:.1f} frames/s\n", name, frames / sw.wall());
+}
+
+int main()
+{
+	const av::topology &topology = av::topology::machine();
+	size_t nb_streams = std::max<size_t>(2, topology.nb_nodes() * 2);
+
+	fmt::print("{} NUMA nodes, {} CPUs, {} streams\n", topology.nb_nodes(),
+		   topology.nb_cpus(), nb_streams);
+
+	for (size_t i = 0; i < nb_streams; i++)
+		if (!generate_clip(clip(i), "libx264", 1280, 720, NB_FRAMES,
+				   "preset=ultrafast"))
+			return -1;
+
+	run("unpinned", nb_streams, false);
+	run("pinned", nb_streams, true);
+
+	return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "common.hpp"
+#include <chrono>
+#include <ctime>
+#include <fmt/core.h>
+
+/*
+ * wall clock and process CPU time elapsed since construction
+ */
+struct stopwatch {
+	stopwatch() { reset(); }
+
+	void reset()
+	{
+		wall0 = std::chrono::steady_clock::now();
+		cpu0 = std::clock();
+	}
+
+	double wall() const
+	{
+		return std::chrono::duration<double>(
+			   std::chrono::steady_clock::now() - wall0)
+		    .count();
+	}
+
+	double cpu() const
+	{
+		return (double)(std::clock() - cpu0) / CLOCKS_PER_SEC;
+	}
+
+	std::chrono::steady_clock::time_point wall0;
+	std::clock_t cpu0;
+};
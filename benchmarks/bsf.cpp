@@ -0,0 +1,75 @@
+#include "bench.hpp"
+
+#define NB_FRAMES 3000
+#define ROUNDS 10
+
+static const std::string source = "/tmp/bsf_source.mkv";
+
+/*
+ * Time the muxing of the clip into the null muxer with the given chain on
+ * the video stream, per packet.
+ */
+static double run(const std::vector<av::packet> &packets, av::input &in,
+		  const std::string &bsfs)
+{
+	int64_t span = packets.back().dts() - packets.front().dts() + 1000;
+	av::output out;
+	double seconds;
+
+	if (!out.open_format("/dev/null", "null"))
+		return 0;
+
+	if (out.add_stream(in, 0, bsfs) < 0)
+		return 0;
+
+	stopwatch sw;
+
+	for (int i = 0; i < ROUNDS; i++) {
+		for (const auto &p : packets) {
+			av::packet q = p;
+
+			q.add_delta_pts(i * span);
+			out.write_norescale(q);
+		}
+	}
+
+	seconds = sw.wall();
+
+	return seconds * 1e9 / (packets.size() * ROUNDS);
+}
+
+int main()
+{
+	std::vector<av::packet> packets;
+	av::input in;
+	av::packet p;
+	double base;
+
+	if (!generate_clip(source, "libx264", 640, 360, NB_FRAMES,
+			   "preset=ultrafast"))
+		return -1;
+
+	if (!in.open(source))
+		return -1;
+
+	while (in >> p)
+		if (p.stream_index() == 0)
+			packets.push_back(p);
+
+	if (packets.empty())
+		return -1;
+
+	base = run(packets, in, "");
+	fmt::print("{:28}: {:.0f} ns/packet\n", "no filter", base);
+
+	for (const std::string bsfs :
+	     {"null", "null,null,null", "h264_mp4toannexb",
+	      "h264_mp4toannexb,dump_extra"}) {
+		double ns = run(packets, in, bsfs);
+
+		fmt::print("{:28}: {:.0f} ns/packet (+{:.0f})\n", bsfs, ns,
+			   ns - base);
+	}
+
+	return 0;
+}
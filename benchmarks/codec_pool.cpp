@@ -0,0 +1,75 @@
+#include "bench.hpp"
+#include "codec_pool.hpp"
+
+#define NB_CLIPS 1000
+#define NB_FRAMES 5
+
+static std::string clip(int i)
+{
+	return fmt::format("/tmp/codec_pool_bench_{:04d}.mkv", i);
+}
+
+/*
+ * thumbnail-like workload: open each clip and decode its first frame
+ */
+template <typename G, typename R>
+static void run(const std::string &name, G get, R release)
+{
+	int done = 0;
+	stopwatch sw;
+
+	for (int i = 0; i < NB_CLIPS; i++) {
+		av::input in;
+		av::packet p;
+		av::frame f;
+
+		if (!in.open(clip(i)))
+			continue;
+
+		av::decoder dec = get(in);
+		if (!dec)
+			continue;
+
+		while (in >> p) {
+			if (p.stream_index() != 0)
+				continue;
+
+			dec << p;
+			if (dec >> f)
+				break;
+		}
+
+		if (!f.f->data[0]) {
+			dec.flush();
+			dec >> f;
+		}
+
+		if (f.f->data[0])
+			done++;
+
+		release(std::move(dec));
+	}
+
+	fmt::print("{:10}: {:.0f} clips/s\n", name, done / sw.wall());
+}
+
+int main()
+{
+	av::codec_pool pool;
+
+	for (int i = 0; i < NB_CLIPS; i++)
+		if (!generate_clip(clip(i), "libx264", 320, 240, NB_FRAMES,
+				   "preset=ultrafast"))
+			return -1;
+
+	run(
+	    "no pool", [](av::input &in) { return in.get(0); },
+	    [](av::decoder &&) {});
+	run(
+	    "codec_pool", [&](av::input &in) { return pool.get(in, 0); },
+	    [&](av::decoder &&dec) { pool.release(std::move(dec)); });
+
+	fmt::print("{} hits, {} misses\n", pool.hits(), pool.misses());
+
+	return 0;
+}
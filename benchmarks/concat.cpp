@@ -0,0 +1,83 @@
+#include "bench.hpp"
+#include "concat.hpp"
+
+#define NB_FILES 24
+#define NB_FRAMES 250
+
+static void report(const std::string &name, uint64_t bytes, double seconds)
+{
+	fmt::print("{:15}: {:.3f}s, {:.1f} MB/s\n", name, seconds,
+		   bytes / seconds / 1e6);
+}
+
+/*
+ * what has to be written without av::concat: each input opened when the
+ * previous one is done, shifted by the duration of the previous ones
+ */
+static void sequential(const std::vector<std::string> &uris)
+{
+	av::output out;
+	av::packet p;
+	uint64_t bytes = 0;
+	int64_t offset = 0, end = 0;
+
+	if (!out.open("/tmp/concat_bench_sequential.ts"))
+		return;
+
+	stopwatch sw;
+
+	for (size_t k = 0; k < uris.size(); k++) {
+		av::input in;
+
+		if (!in.open(uris[k]))
+			return;
+
+		if (k == 0)
+			out.add_stream(in, 0);
+
+		while (in >> p) {
+			p.add_delta_pts(offset);
+			end = std::max(end, p.pts() + 1);
+			bytes += p.size();
+			out << p;
+		}
+
+		offset = end;
+	}
+
+	report("sequential", bytes, sw.wall());
+}
+
+static void joined(const std::vector<std::string> &uris)
+{
+	av::output out;
+	av::concat_stats stats;
+
+	if (!out.open("/tmp/concat_bench_concat.ts"))
+		return;
+
+	stopwatch sw;
+
+	if (!av::concat(uris, out, "", &stats))
+		return;
+
+	report("av::concat", stats.bytes, sw.wall());
+}
+
+int main()
+{
+	std::vector<std::string> uris;
+
+	// an hour of recording per file, scaled down to 10s
+	for (int i = 0; i < NB_FILES; i++) {
+		uris.push_back(fmt::format("/tmp/concat_bench_{}.mkv", i));
+		if (!generate_clip(uris.back(), "libx264", 1280, 720, NB_FRAMES,
+				   "preset=ultrafast"))
+			return -1;
+	}
+
+	sequential(uris);
+	joined(uris);
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include "bench.hpp"
+#include "edit.hpp"
+
+#define FPS 25
+
+static const std::string clip = "/tmp/smart_cut_bench.mkv";
+
+/*
+ * decoding and re-encoding every frame of the range, the way it is done
+ * without smart cut
+ */
+static void transcode(double start, double end)
+{
+	av::input in;
+	av::output out;
+	av::packet p;
+	av::frame f;
+
+	if (!in.open(clip) || !out.open("/tmp/smart_cut_bench_full.ts"))
+		return;
+
+	av::decoder dec = in.get(0);
+	av::encoder enc = out.add_stream(
+	    "libx264", "video_size=1280x720:pixel_format=yuv420p:"
+		       "time_base=1/1000");
+	if (!dec || !enc)
+		return;
+
+	stopwatch sw;
+	int64_t from = start * 1000, to = end * 1000;
+
+	auto encode = [&]() {
+		while (dec >> f) {
+			if (f.f->pts < from || f.f->pts >= to)
+				continue;
+
+			f.f->pts -= from;
+			f.f->pict_type = AV_PICTURE_TYPE_NONE;
+			enc << f;
+			while (enc >> p)
+				out << p;
+		}
+	};
+
+	while (in >> p) {
+		if (p.pts() >= to)
+			break;
+		dec << p;
+		encode();
+	}
+	dec.flush();
+	encode();
+	enc.flush();
+	while (enc >> p)
+		out << p;
+
+	fmt::print("full transcode: {:.3f}s\n", sw.wall());
+}
+
+static void cut(double start, double end)
+{
+	av::input in;
+	av::output out;
+	av::cut_stats stats;
+
+	if (!in.open(clip) || !out.open("/tmp/smart_cut_bench_smart.ts"))
+		return;
+
+	stopwatch sw;
+
+	if (!av::smart_cut(in, out, start, end, "", "", &stats))
+		return;
+
+	fmt::print("smart cut:      {:.3f}s ({} copied, {} encoded)\n",
+		   sw.wall(), stats.copied, stats.encoded);
+}
+
+int main()
+{
+	// 2 minutes, 10s GOPs
+	if (!generate_clip(clip, "libx264", 1280, 720, 120 * FPS,
+			   "g=250:preset=veryfast"))
+		return 1;
+
+	transcode(10.3, 110.7);
+	cut(10.3, 110.7);
+
+	return 0;
+}
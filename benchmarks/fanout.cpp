@@ -0,0 +1,129 @@
+#include "bench.hpp"
+#include "fanout.hpp"
+#include <thread>
+#include <vector>
+
+#define NB_FRAMES 250
+
+struct rendition {
+	int width, height;
+};
+
+static const std::vector<rendition> ladder = {
+    {1920, 1080}, {1280, 720}, {854, 480}, {640, 360}};
+
+static const std::string source = "/tmp/fanout_source.mkv";
+
+static std::string encoder_options(const rendition &r)
+{
+	return fmt::format("video_size={}x{}:pixel_format=yuv420p:"
+			   "time_base=1/25:preset=ultrafast",
+			   r.width, r.height);
+}
+
+static void transcode(const rendition &r)
+{
+	av::input in;
+	av::output out;
+	av::decoder dec;
+	av::encoder enc;
+	av::packet p;
+	av::frame f;
+
+	if (!in.open(source))
+		return;
+
+	if (!out.open(fmt::format("/tmp/fanout_independent_{}p.mkv", r.height)))
+		return;
+
+	dec = in.get(0);
+	enc = out.add_stream("libx264", encoder_options(r));
+	av::frame::scaler scaler(AV_PIX_FMT_YUV420P, r.width, r.height);
+
+	auto encode = [&](const av::frame &frame) {
+		av::frame scaled = scaler.scale(frame);
+
+		scaled.f->pts = frame.f->pts;
+		enc << scaled;
+		while (enc >> p)
+			out << p;
+	};
+
+	while (in >> p) {
+		dec << p;
+		while (dec >> f)
+			encode(f);
+	}
+
+	dec.flush();
+	while (dec >> f)
+		encode(f);
+
+	enc.flush();
+	while (enc >> p)
+		out << p;
+}
+
+static void independent()
+{
+	std::vector<std::thread> threads;
+
+	for (auto &r : ladder)
+		threads.emplace_back(transcode, r);
+
+	for (auto &t : threads)
+		t.join();
+}
+
+static void shared_decode()
+{
+	av::input in;
+	av::output out;
+	av::decoder dec;
+	av::packet p;
+	av::frame f;
+
+	if (!in.open(source) || !out.open("/tmp/fanout_ladder.mkv"))
+		return;
+
+	dec = in.get(0);
+
+	av::fanout ladder_fanout;
+
+	for (auto &r : ladder)
+		ladder_fanout.add_branch(
+		    out.add_stream("libx264", encoder_options(r)), out);
+
+	while (in >> p) {
+		dec << p;
+		while (dec >> f)
+			ladder_fanout << f;
+	}
+
+	dec.flush();
+	while (dec >> f)
+		ladder_fanout << f;
+
+	ladder_fanout.flush();
+}
+
+int main()
+{
+	if (!generate_clip(source, "libx264", 1920, 1080, NB_FRAMES,
+			   "preset=ultrafast"))
+		return -1;
+
+	stopwatch sw;
+
+	independent();
+	fmt::print("{} independent transcodes: {:.2f}s wall, {:.2f}s CPU\n",
+		   ladder.size(), sw.wall(), sw.cpu());
+
+	sw.reset();
+
+	shared_decode();
+	fmt::print("single decode fan-out:    {:.2f}s wall, {:.2f}s CPU\n",
+		   sw.wall(), sw.cpu());
+
+	return 0;
+}
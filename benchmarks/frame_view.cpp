@@ -0,0 +1,66 @@
+#include "bench.hpp"
+#include <cstring>
+
+#define NB_RUNS 200
+
+/*
+ * generate_frame fill before frame_view
+ */
+static void raw_fill(AVFrame *f, int index, int width, int height)
+{
+	int x, y;
+
+	/* Y */
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+			f->data[0][y * f->linesize[0] + x] = x + y + index * 3;
+
+	/* Cb and Cr */
+	for (y = 0; y < height / 2; y++) {
+		for (x = 0; x < width / 2; x++) {
+			f->data[1][y * f->linesize[1] + x] =
+			    128 + y + index * 2;
+			f->data[2][y * f->linesize[2] + x] = 64 + x + index * 5;
+		}
+	}
+}
+
+template <typename F>
+static double run(const std::string &name, av::frame &f, F fill)
+{
+	stopwatch sw;
+
+	for (int i = 0; i < NB_RUNS; i++)
+		fill(f.f, i, f.f->width, f.f->height);
+
+	double ms = sw.wall() * 1000 / NB_RUNS;
+
+	fmt::print("{:10}: {:.3f}ms/frame\n", name, ms);
+	return ms;
+}
+
+int main()
+{
+	av::frame raw, view;
+
+	// allocate both frames the same way
+	generate_frame(raw.f, 0, 1920, 1080);
+	generate_frame(view.f, 0, 1920, 1080);
+
+	run("raw", raw, raw_fill);
+	run("frame_view", view, generate_frame);
+
+	for (int p = 0; p < 3; p++) {
+		int h = p ? 540 : 1080, w = p ? 960 : 1920;
+
+		for (int y = 0; y < h; y++)
+			if (memcmp(raw.f->data[p] + y * raw.f->linesize[p],
+				   view.f->data[p] + y * view.f->linesize[p],
+				   w)) {
+				fmt::print(stderr, "fills differ\n");
+				return -1;
+			}
+	}
+
+	return 0;
+}
@@ -0,0 +1,53 @@
+#include "bench.hpp"
+#include "hash.hpp"
+
+extern "C" {
+#include <libavutil/md5.h>
+}
+
+#define NB_RUNS 100
+
+/*
+ * xxh3 over the frame planes, against md5 like ffmpeg's framemd5
+ */
+static void run(int width, int height)
+{
+	av::frame f;
+	uint64_t sink = 0;
+	uint8_t md5[16];
+
+	generate_frame(f.f, 0, width, height);
+
+	size_t size = av::hash(f).size;
+
+	stopwatch sw;
+
+	for (int i = 0; i < NB_RUNS; i++)
+		sink += av::hash(f).all;
+
+	double xxh3 = size * NB_RUNS / sw.wall() / 1e9;
+
+	sw.reset();
+
+	for (int i = 0; i < NB_RUNS; i++)
+		for (int plane = 0; plane < 3; plane++)
+			av_md5_sum(md5, f.f->data[plane],
+				   f.f->linesize[plane] *
+				       (plane ? height / 2 : height));
+
+	double md5_rate = size * NB_RUNS / sw.wall() / 1e9;
+
+	fmt::print("{}x{}: xxh3 {:.2f} GB/s, md5 {:.2f} GB/s ({:x})\n",
+		   width, height, xxh3, md5_rate, sink & 0xf);
+}
+
+int main()
+{
+	std::vector<std::pair<int, int>> sizes = {
+	    {640, 360}, {1920, 1080}, {3840, 2160}};
+
+	for (auto &size : sizes)
+		run(size.first, size.second);
+
+	return 0;
+}
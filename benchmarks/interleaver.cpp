@@ -0,0 +1,137 @@
+#include "bench.hpp"
+#include "interleaver.hpp"
+#include "queue.hpp"
+#include <thread>
+#include <vector>
+
+#define NB_PRODUCERS 16
+#define NB_LOOPS 40
+
+static const std::string source = "/tmp/interleaver_source.mkv";
+
+/*
+ * the packets of the source clip, replayed NB_LOOPS times by each producer
+ */
+static std::vector<av::packet> load(int64_t &duration)
+{
+	std::vector<av::packet> packets;
+	av::input in;
+	av::packet p;
+
+	if (!in.open(source))
+		return packets;
+
+	while (in >> p)
+		packets.push_back(p);
+
+	duration = packets.back().pts() + 40;
+	return packets;
+}
+
+static void produce(const std::vector<av::packet> &packets,
+		    int64_t duration, int index, auto submit)
+{
+	for (int loop = 0; loop < NB_LOOPS; loop++) {
+		for (auto &packet : packets) {
+			av::packet p = packet;
+
+			p.stream_index(index);
+			p.add_delta_pts(loop * duration);
+
+			if (!submit(p))
+				return;
+		}
+	}
+}
+
+static void open_output(av::output &out)
+{
+	av::input in;
+
+	in.open(source);
+	out.open_format("/dev/null", "null");
+
+	for (int i = 0; i < NB_PRODUCERS; i++)
+		out.add_stream(in, 0);
+}
+
+static void mutex_queue(const std::vector<av::packet> &packets,
+			int64_t duration)
+{
+	std::vector<std::thread> producers;
+	av::bounded_queue<av::packet> q(1024);
+	av::output out;
+	av::packet p;
+	stopwatch sw;
+	size_t count = 0;
+
+	open_output(out);
+
+	for (int i = 0; i < NB_PRODUCERS; i++)
+		producers.emplace_back([&, i]() {
+			produce(packets, duration, i,
+				[&](const av::packet &p) { return q.push(p); });
+		});
+
+	std::thread closer([&]() {
+		for (auto &t : producers)
+			t.join();
+		q.close();
+	});
+
+	while (q.pop(p)) {
+		out << p;
+		count++;
+	}
+
+	closer.join();
+
+	fmt::print("mutex queue: {:.0f} packets/s\n", count / sw.wall());
+}
+
+static void lock_free(const std::vector<av::packet> &packets,
+		      int64_t duration)
+{
+	std::vector<std::thread> producers;
+	av::output out;
+	stopwatch sw;
+
+	open_output(out);
+
+	av::interleaver il(out, NB_PRODUCERS);
+
+	for (int i = 0; i < NB_PRODUCERS; i++)
+		producers.emplace_back([&, i]() {
+			produce(packets, duration, i,
+				[&](const av::packet &p) {
+					return il.submit(i, p);
+				});
+			il.finish(i);
+		});
+
+	for (auto &t : producers)
+		t.join();
+
+	il.close();
+
+	fmt::print("interleaver: {:.0f} packets/s, {} out of order\n",
+		   il.written() / sw.wall(), il.late());
+}
+
+int main()
+{
+	int64_t duration;
+
+	if (!generate_clip(source, "libx264", 320, 240, 250,
+			   "preset=ultrafast"))
+		return -1;
+
+	auto packets = load(duration);
+	if (packets.empty())
+		return -1;
+
+	mutex_queue(packets, duration);
+	lock_free(packets, duration);
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+#include "bench.hpp"
+#include "job_engine.hpp"
+#include <thread>
+
+#define NB_CLIPS 64
+#define NB_FRAMES 50
+
+static std::string clip(int i)
+{
+	return fmt::format("/tmp/job_engine_bench_{:02d}.mkv", i);
+}
+
+/*
+ * half-size mpeg4 proxy of a clip, with the codecs and scaler either new
+ * (no context) or taken from the worker's job_context
+ */
+static bool transcode(int i, av::job_context *ctx)
+{
+	std::string enc_opts = "video_size=160x120:pixel_format=yuv420p:"
+			       "time_base=1/25";
+	std::unique_ptr<av::frame::scaler> own;
+	av::frame::scaler *scaler;
+	av::input in;
+	av::output out;
+	av::decoder dec;
+	av::encoder enc;
+	av::packet p;
+	av::frame f;
+
+	if (!in.open(clip(i)) ||
+	    !out.open(fmt::format("/tmp/job_engine_out_{:02d}.mkv", i)))
+		return false;
+
+	if (ctx) {
+		enc_opts = ctx->codec_options(enc_opts);
+
+		dec = ctx->codecs.get(in, 0, "", ctx->codec_options());
+		enc = ctx->codecs.get(out, "mpeg4", enc_opts);
+		scaler = &ctx->scaler(AV_PIX_FMT_YUV420P, 160, 120);
+	} else {
+		dec = in.get(0);
+		enc = out.add_stream("mpeg4", enc_opts);
+		own = std::make_unique<av::frame::scaler>(AV_PIX_FMT_YUV420P,
+							  160, 120);
+		scaler = own.get();
+	}
+
+	if (!dec || !enc)
+		return false;
+
+	auto encode = [&]() {
+		while (dec >> f) {
+			av::frame scaled = scaler->scale(f);
+
+			scaled.f->pts = f.f->pts;
+			enc << scaled;
+
+			while (enc >> p)
+				out << p;
+		}
+	};
+
+	while (in >> p) {
+		if (ctx && ctx->cancelled())
+			return false;
+
+		dec << p;
+		encode();
+	}
+
+	dec.flush();
+	encode();
+
+	enc.flush();
+	while (enc >> p)
+		out << p;
+
+	if (ctx) {
+		ctx->codecs.release(std::move(dec));
+		ctx->codecs.release(std::move(enc));
+	}
+
+	return true;
+}
+
+int main()
+{
+	for (int i = 0; i < NB_CLIPS; i++)
+		if (!generate_clip(clip(i), "libx264", 320, 240, NB_FRAMES,
+				   "preset=ultrafast"))
+			return -1;
+
+	{
+		std::vector<std::thread> threads;
+		stopwatch sw;
+
+		for (int i = 0; i < NB_CLIPS; i++)
+			threads.emplace_back(transcode, i, nullptr);
+
+		for (auto &t : threads)
+			t.join();
+
+		fmt::print("{:16}: {:.1f} files/s\n", "thread per file",
+			   NB_CLIPS / sw.wall());
+	}
+
+	{
+		av::job_engine engine;
+		stopwatch sw;
+
+		for (int i = 0; i < NB_CLIPS; i++)
+			engine.submit([i](av::job_context &ctx) {
+				return transcode(i, &ctx);
+			});
+
+		engine.wait();
+
+		fmt::print("{:16}: {:.1f} files/s ({} failed)\n", "job_engine",
+			   NB_CLIPS / sw.wall(), engine.failed());
+	}
+
+	return 0;
+}
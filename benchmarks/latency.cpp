@@ -0,0 +1,112 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <vector>
+
+#define NB_FRAMES 125
+
+static const std::string source = "/tmp/latency_source.ts";
+
+/*
+ * read the source at its real frame rate, decode, encode and mux it, and
+ * report the delay of each frame from input::read to output::write
+ */
+static void run(const std::string &name, bool low_latency)
+{
+	std::string in_opts, dec_opts, enc_opts;
+	std::map<int64_t, stopwatch> reads;
+	std::vector<double> latencies;
+	av::input in;
+	av::output out;
+	av::decoder dec;
+	av::encoder enc;
+	av::packet p;
+	av::frame f;
+
+	enc_opts = "video_size=1280x720:pixel_format=yuv420p:"
+		   "time_base=1/90000:preset=ultrafast";
+
+	if (low_latency) {
+		in_opts = av::low_latency::input_options(source);
+		dec_opts = av::low_latency::decoder_options();
+		enc_opts =
+		    av::low_latency::encoder_options("libx264", enc_opts);
+	}
+
+	if (!in.open(source, in_opts) || !out.open("/tmp/latency_out.ts"))
+		return;
+
+	dec = in.get(0, "", dec_opts);
+	enc = out.add_stream("libx264", enc_opts);
+	if (!dec || !enc)
+		return;
+
+	auto write = [&]() {
+		while (enc >> p) {
+			auto read = reads.find(p.pts());
+
+			out << p;
+
+			if (read != reads.end())
+				latencies.push_back(read->second.wall() * 1e3);
+		}
+	};
+
+	stopwatch clock;
+	AVRational tb = in.time_base(0);
+	int64_t first = AV_NOPTS_VALUE;
+
+	while (in >> p) {
+		if (first == AV_NOPTS_VALUE)
+			first = p.pts();
+
+		// pace the reads like a live source
+		double due = (p.pts() - first) * av_q2d(tb);
+		if (due > clock.wall())
+			std::this_thread::sleep_for(
+			    std::chrono::duration<double>(due - clock.wall()));
+
+		reads[p.pts()] = stopwatch();
+
+		dec << p;
+		while (dec >> f) {
+			enc << f;
+			write();
+		}
+	}
+
+	dec.flush();
+	while (dec >> f) {
+		enc << f;
+		write();
+	}
+
+	enc.flush();
+	write();
+
+	if (latencies.empty())
+		return;
+
+	std::sort(latencies.begin(), latencies.end());
+
+	auto percentile = [&](double q) {
+		return latencies[(size_t)(q * (latencies.size() - 1))];
+	};
+
+	fmt::print("{:11}: {} frames, latency p50 {:.1f}ms p90 {:.1f}ms "
+		   "p99 {:.1f}ms max {:.1f}ms\n",
+		   name, latencies.size(), percentile(0.5), percentile(0.9),
+		   percentile(0.99), latencies.back());
+}
+
+int main()
+{
+	if (!generate_clip(source, "libx264", 1280, 720, NB_FRAMES))
+		return -1;
+
+	run("default", false);
+	run("low latency", true);
+
+	return 0;
+}
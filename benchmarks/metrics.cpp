@@ -0,0 +1,68 @@
+#include "bench.hpp"
+#include "metrics.hpp"
+
+#define NB_RUNS 20
+#define WIDTH 1920
+#define HEIGHT 1080
+
+/*
+ * a 10-bit version of the generate_frame pattern
+ */
+static void generate_frame10(av::frame &f, int index)
+{
+	f.f->format = AV_PIX_FMT_YUV420P10LE;
+	f.f->width = WIDTH;
+	f.f->height = HEIGHT;
+	av_frame_get_buffer(f.f, 0);
+
+	av::frame_view<AV_PIX_FMT_YUV420P10LE> v(f);
+	if (!v)
+		return;
+
+	for (int p = 0; p < 3; p++)
+		for (int y = 0; y < v.height(p); y++) {
+			auto row = v.row(p, y);
+
+			for (int x = 0; x < v.width(p); x++)
+				row[x] = (x * 4 + y * 2 + index * p * 7) & 1023;
+		}
+}
+
+template <typename F>
+static void run(const std::string &name, const av::frame &a,
+		const av::frame &b, F metric)
+{
+	double value = 0;
+
+	for (bool simd : {false, true}) {
+		av::metrics::set_simd(simd);
+		if (simd && !av::metrics::simd())
+			break;
+
+		stopwatch sw;
+
+		for (int i = 0; i < NB_RUNS; i++)
+			value = metric(a, b).all;
+
+		fmt::print("{:12} {:6}: {:7.1f} Mpixel/s ({:.4f})\n", name,
+			   simd ? "avx2" : "scalar",
+			   WIDTH * HEIGHT * NB_RUNS / sw.wall() / 1e6, value);
+	}
+}
+
+int main()
+{
+	av::frame a8, b8, a10, b10;
+
+	generate_frame(a8.f, 0, WIDTH, HEIGHT);
+	generate_frame(b8.f, 3, WIDTH, HEIGHT);
+	generate_frame10(a10, 0);
+	generate_frame10(b10, 3);
+
+	run("psnr 8-bit", a8, b8, av::metrics::psnr);
+	run("ssim 8-bit", a8, b8, av::metrics::ssim);
+	run("psnr 10-bit", a10, b10, av::metrics::psnr);
+	run("ssim 10-bit", a10, b10, av::metrics::ssim);
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include "bench.hpp"
+#include "negotiation.hpp"
+
+#define NB_FRAMES 100
+
+/*
+ * YUV420P frames to libx264: an unconditional scaler against the
+ * converter, which passes them through
+ */
+static void run(int width, int height, bool negotiated)
+{
+	av::output out;
+	av::packet p;
+	std::vector<av::frame> frames(NB_FRAMES);
+	double convert = 0;
+
+	for (int i = 0; i < NB_FRAMES; i++)
+		generate_frame(frames[i].f, i, width, height);
+
+	if (!out.open("/tmp/negotiation_bench.mkv"))
+		return;
+
+	av::encoder enc = out.add_stream(
+	    "libx264", fmt::format("video_size={}x{}:pixel_format=yuv420p:"
+				   "time_base=1/25:preset=ultrafast",
+				   width, height));
+	if (!enc)
+		return;
+
+	av::frame::scaler scaler(AV_PIX_FMT_YUV420P, width, height);
+	av::converter converter(enc);
+
+	stopwatch total;
+
+	for (auto &f : frames) {
+		stopwatch sw;
+		av::frame c;
+
+		if (negotiated)
+			c = converter.convert(f);
+		else {
+			c = scaler.scale(f);
+			c.f->pts = f.f->pts;
+		}
+
+		convert += sw.wall();
+
+		enc << c;
+		while (enc >> p)
+			out << p;
+	}
+
+	enc.flush();
+	while (enc >> p)
+		out << p;
+
+	fmt::print("{}x{} {:10}: conversion {:.3f}ms/frame, total {:.3f}ms/"
+		   "frame\n",
+		   width, height, negotiated ? "negotiated" : "scaler",
+		   convert * 1000 / NB_FRAMES, total.wall() * 1000 / NB_FRAMES);
+}
+
+int main()
+{
+	std::vector<std::pair<int, int>> sizes = {{1280, 720}, {1920, 1080}};
+
+	for (auto &size : sizes) {
+		run(size.first, size.second, false);
+		run(size.first, size.second, true);
+	}
+
+	return 0;
+}
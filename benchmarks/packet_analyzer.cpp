@@ -0,0 +1,85 @@
+#include "bench.hpp"
+#include "packet_analyzer.hpp"
+
+#define FPS 25
+
+static const std::string clip = "/tmp/packet_analyzer_bench.mkv";
+
+static std::vector<av::packet> demux(av::input &in)
+{
+	std::vector<av::packet> packets;
+	av::packet p;
+
+	while (in >> p)
+		packets.push_back(p);
+
+	return packets;
+}
+
+static void analyze(av::input &in, const std::vector<av::packet> &packets)
+{
+	av::packet_analyzer analyzer;
+
+	if (!analyzer.open(in))
+		return;
+
+	stopwatch sw;
+
+	for (auto &p : packets)
+		analyzer << p;
+
+	double rate = packets.size() / sw.cpu();
+
+	fmt::print("analyzer: {:10.0f} packets/s, {:6.0f} {}fps streams/core\n",
+		   rate, rate / FPS, FPS);
+}
+
+static void decode(av::input &in, const std::vector<av::packet> &packets)
+{
+	av::decoder dec = in.get(0, "", "threads=1");
+	av::frame f;
+
+	if (!dec)
+		return;
+
+	stopwatch sw;
+
+	for (auto &p : packets) {
+		dec << p;
+		while (dec >> f)
+			;
+	}
+	dec.flush();
+	while (dec >> f)
+		;
+
+	double rate = packets.size() / sw.cpu();
+
+	fmt::print("decoder:  {:10.0f} packets/s, {:6.0f} {}fps streams/core\n",
+		   rate, rate / FPS, FPS);
+}
+
+int main()
+{
+	std::vector<std::pair<int, int>> sizes = {{640, 360}, {1920, 1080}};
+
+	for (auto &size : sizes) {
+		av::input in;
+
+		if (!generate_clip(clip, "libx264", size.first, size.second,
+				   1000, "g=50:bf=3"))
+			return 1;
+
+		if (!in.open(clip))
+			return 1;
+
+		// both work on packets already in memory
+		auto packets = demux(in);
+
+		fmt::print("{}x{}\n", size.first, size.second);
+		analyze(in, packets);
+		decode(in, packets);
+	}
+
+	return 0;
+}
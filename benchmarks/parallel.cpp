@@ -0,0 +1,50 @@
+#include "bench.hpp"
+#include "parallel.hpp"
+#include <array>
+#include <cmath>
+#include <thread>
+
+#define NB_RUNS 50
+
+/*
+ * gamma correction through a lookup table on the three planes
+ */
+static void run(int width, int height, size_t nb_threads)
+{
+	av::thread_pool pool(nb_threads);
+	std::array<uint8_t, 256> lut;
+	av::frame f;
+
+	for (int i = 0; i < 256; i++)
+		lut[i] = std::lround(255 * std::pow(i / 255.0, 1 / 2.2));
+
+	generate_frame(f.f, 0, width, height);
+
+	stopwatch sw;
+
+	for (int i = 0; i < NB_RUNS; i++)
+		for (int plane = 0; plane < 3; plane++)
+			av::parallel_for_rows(
+			    f, plane,
+			    [&](std::span<uint8_t> row, int) {
+				    for (auto &p : row)
+					    p = lut[p];
+			    },
+			    pool);
+
+	fmt::print("{}x{} {:2} threads: {:.3f}ms/frame\n", width, height,
+		   nb_threads, sw.wall() * 1000 / NB_RUNS);
+}
+
+int main()
+{
+	size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<std::pair<int, int>> sizes = {{1920, 1080}, {3840, 2160}};
+
+	for (auto &size : sizes)
+		for (size_t n = 1; n <= cores; n *= 2)
+			run(size.first, size.second, n);
+
+	return 0;
+}
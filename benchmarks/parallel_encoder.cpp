@@ -0,0 +1,98 @@
+#include "bench.hpp"
+#include "parallel_encoder.hpp"
+#include <thread>
+
+#define NB_FRAMES 200
+#define WIDTH 1920
+#define HEIGHT 1080
+
+static std::vector<av::frame> frames()
+{
+	std::vector<av::frame> v(NB_FRAMES);
+
+	for (int i = 0; i < NB_FRAMES; i++)
+		generate_frame(v[i].f, i, WIDTH, HEIGHT);
+
+	return v;
+}
+
+static std::string options(const std::string &extra)
+{
+	return fmt::format("video_size={}x{}:pixel_format=yuv420p:"
+			   "time_base=1/25:threads=1{}",
+			   WIDTH, HEIGHT, extra);
+}
+
+/*
+ * one encoder instance, the baseline
+ */
+static void single(const std::vector<av::frame> &v, const std::string &codec,
+		   const std::string &extra)
+{
+	av::output out;
+	av::packet p;
+
+	if (!out.open("/tmp/parallel_encoder_bench.mkv"))
+		return;
+
+	av::encoder enc = out.add_stream(codec, options(extra));
+	if (!enc)
+		return;
+
+	stopwatch sw;
+
+	for (auto &f : v) {
+		enc << f;
+		while (enc >> p)
+			out << p;
+	}
+
+	enc.flush();
+	while (enc >> p)
+		out << p;
+
+	fmt::print("{:6} single encoder: {:7.1f} fps\n", codec,
+		   NB_FRAMES / sw.wall());
+}
+
+static void parallel(const std::vector<av::frame> &v,
+		     const std::string &codec, const std::string &extra,
+		     size_t nb_instances)
+{
+	av::parallel_encoder enc;
+	av::output out;
+
+	if (!out.open("/tmp/parallel_encoder_bench.mkv"))
+		return;
+
+	if (!enc.open(out, codec, options(extra), nb_instances))
+		return;
+
+	stopwatch sw;
+
+	for (auto &f : v)
+		enc << f;
+
+	enc.flush();
+
+	fmt::print("{:6} {:2} instances: {:7.1f} fps\n", codec, nb_instances,
+		   NB_FRAMES / sw.wall());
+}
+
+int main()
+{
+	size_t cores = std::max(1u, std::thread::hardware_concurrency());
+	auto v = frames();
+
+	// mjpeg takes limited range yuv420p in unofficial mode
+	std::vector<std::pair<std::string, std::string>> codecs = {
+	    {"mjpeg", ":strict=-1"}, {"ffv1", ""}};
+
+	for (auto &c : codecs) {
+		single(v, c.first, c.second);
+		for (size_t n = 2; n <= cores; n *= 2)
+			parallel(v, c.first, c.second, n);
+	}
+
+	return 0;
+}
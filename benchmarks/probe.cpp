@@ -0,0 +1,59 @@
+#include "bench.hpp"
+
+#define NB_FRAMES 250
+#define NB_RUNS 20
+
+template <typename F>
+static void run(const std::string &source, const std::string &name, F open)
+{
+	double total = 0;
+
+	for (int i = 0; i < NB_RUNS; i++) {
+		av::input in;
+		av::packet p;
+		stopwatch sw;
+
+		if (!open(in) || !(in >> p))
+			return;
+
+		total += sw.wall();
+	}
+
+	fmt::print("{:24} {:8}: {:.2f}ms to first packet\n", source, name,
+		   total * 1000 / NB_RUNS);
+}
+
+/*
+ * mpegts has no header, its streams come with the first packets; mkv
+ * declares them in its header
+ */
+int main()
+{
+	for (std::string source : {"/tmp/probe_source.ts",
+				   "/tmp/probe_source.mkv"}) {
+		if (!generate_clip(source, "libx264", 1280, 720, NB_FRAMES,
+				   "preset=ultrafast"))
+			return -1;
+
+		run(source, "full",
+		    [&](av::input &in) { return in.open(source); });
+		run(source, "fast", [&](av::input &in) {
+			return in.open(source, av::probe::fast);
+		});
+		run(source, "minimal", [&](av::input &in) {
+			return in.open(source, av::probe::minimal);
+		});
+
+		av::input probed;
+
+		if (!probed.open(source))
+			return -1;
+
+		av::stream_info info = probed.get_stream_info();
+
+		run(source, "cached",
+		    [&](av::input &in) { return in.open(source, info); });
+	}
+
+	return 0;
+}
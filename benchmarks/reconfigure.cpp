@@ -0,0 +1,114 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <numeric>
+
+#define NB_FRAMES 500
+#define SWITCH 250
+#define WIDTH 1280
+#define HEIGHT 720
+
+static const std::string options =
+    "video_size=1280x720:pixel_format=yuv420p:time_base=1/25:"
+    "preset=ultrafast:tune=zerolatency:g=50";
+
+static const std::string high = "b=4M:maxrate=4M:bufsize=4M";
+static const std::string low = "b=1M:maxrate=1M:bufsize=1M";
+
+static void report(const std::string &name, const std::vector<double> &t)
+{
+	double mean = std::accumulate(t.begin(), t.end(), 0.0) / t.size();
+
+	fmt::print("{:12}: mean {:.2f}ms, switch frame {:.2f}ms, "
+		   "max {:.2f}ms\n",
+		   name, mean * 1e3, t[SWITCH] * 1e3,
+		   *std::max_element(t.begin(), t.end()) * 1e3);
+}
+
+/*
+ * time from sending a frame to getting its packets, the bitrate lowered
+ * at frame SWITCH with a keyframe to start the new rendition on
+ */
+static void reconfigure()
+{
+	std::vector<double> latencies;
+	av::output out;
+	av::frame f;
+	av::packet p;
+
+	if (!out.open("/tmp/reconfigure_bench.ts"))
+		return;
+
+	av::encoder enc = out.add_stream("libx264", options + ":" + high);
+	if (!enc)
+		return;
+
+	for (int i = 0; i < NB_FRAMES; i++) {
+		generate_frame(f.f, i, WIDTH, HEIGHT);
+
+		stopwatch sw;
+
+		if (i == SWITCH && !enc.reconfigure(low + ":keyframe=1"))
+			return;
+
+		enc << f;
+		while (enc >> p)
+			out << p;
+
+		latencies.push_back(sw.wall());
+	}
+
+	report("reconfigure", latencies);
+}
+
+/*
+ * the same switch done by draining the encoder and opening a new one
+ */
+static void reopen()
+{
+	std::vector<double> latencies;
+	av::output first, second;
+	av::frame f;
+	av::packet p;
+
+	if (!first.open("/tmp/reopen_bench_0.ts") ||
+	    !second.open("/tmp/reopen_bench_1.ts"))
+		return;
+
+	av::encoder enc = first.add_stream("libx264", options + ":" + high);
+	if (!enc)
+		return;
+
+	for (int i = 0; i < NB_FRAMES; i++) {
+		av::output &out = i < SWITCH ? first : second;
+
+		generate_frame(f.f, i, WIDTH, HEIGHT);
+
+		stopwatch sw;
+
+		if (i == SWITCH) {
+			enc.flush();
+			while (enc >> p)
+				first << p;
+
+			enc = second.add_stream("libx264", options + ":" + low);
+			if (!enc)
+				return;
+		}
+
+		enc << f;
+		while (enc >> p)
+			out << p;
+
+		latencies.push_back(sw.wall());
+	}
+
+	report("reopen", latencies);
+}
+
+int main()
+{
+	reconfigure();
+	reopen();
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include "bench.hpp"
+
+#define NB_FRAMES 3000
+
+static const std::string source = "/tmp/remux_source.mkv";
+
+static void report(const std::string &name, uint64_t packets, uint64_t bytes,
+		   double seconds)
+{
+	fmt::print("{:11}: {:.0f} packets/s, {:.1f} MB/s\n", name,
+		   packets / seconds, bytes / seconds / 1e6);
+}
+
+static void packet_loop()
+{
+	av::input in;
+	av::output out;
+	av::packet p;
+	uint64_t packets = 0, bytes = 0;
+
+	if (!in.open(source) || !out.open("/tmp/remux_loop.ts"))
+		return;
+
+	out.add_stream(in, 0);
+
+	stopwatch sw;
+
+	while (in >> p) {
+		packets++;
+		bytes += p.size();
+		out << p;
+	}
+
+	report("packet loop", packets, bytes, sw.wall());
+}
+
+static void fast_path()
+{
+	av::input in;
+	av::output out;
+	av::remux_progress last = {0, 0, 0};
+
+	if (!in.open(source) || !out.open("/tmp/remux_fast.ts"))
+		return;
+
+	out.add_stream(in, 0);
+
+	stopwatch sw;
+
+	av::remux(in, out, {0}, [&](const av::remux_progress &progress) {
+		last = progress;
+		return true;
+	});
+
+	report("av::remux", last.packets, last.bytes, sw.wall());
+}
+
+int main()
+{
+	if (!generate_clip(source, "libx264", 1280, 720, NB_FRAMES,
+			   "preset=ultrafast"))
+		return -1;
+
+	packet_loop();
+	fast_path();
+
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include "bench.hpp"
+#include "segmenter.hpp"
+#include <algorithm>
+#include <vector>
+
+#define NB_FRAMES 1500
+
+static const std::string source = "/tmp/segmenter_source.mkv";
+
+/*
+ * write the source packets through a segmenter and return the per write
+ * latencies in microseconds, separating the writes that rotated
+ */
+static void run(const std::string &format, bool preopen)
+{
+	av::input in;
+	av::segmenter seg;
+	av::packet p;
+	std::vector<double> steady, rotation;
+
+	if (!in.open(source))
+		return;
+
+	std::string ext = format == "mpegts" ? "ts" : "mp4";
+
+	if (!seg.open("/tmp/segment-{:03d}." + ext, 2.0, format, "", preopen))
+		return;
+
+	seg.add_stream(in, 0);
+
+	while (in >> p) {
+		int index = seg.segment();
+		stopwatch sw;
+
+		seg << p;
+
+		double us = sw.wall() * 1e6;
+
+		if (seg.segment() != index)
+			rotation.push_back(us);
+		else
+			steady.push_back(us);
+	}
+
+	std::sort(steady.begin(), steady.end());
+
+	fmt::print("{:6} preopen={:d}: {} segments, steady p50 {:.1f}us "
+		   "max {:.1f}us, rotation max {:.1f}us\n",
+		   format, preopen, seg.segment() + 1,
+		   steady[steady.size() / 2], steady.back(),
+		   rotation.empty() ? 0.0
+				    : *std::max_element(rotation.begin(),
+							rotation.end()));
+}
+
+int main()
+{
+	if (!generate_clip(source, "libx264", 1280, 720, NB_FRAMES,
+			   "preset=ultrafast:g=25"))
+		return -1;
+
+	for (auto format : {"mpegts", "mp4"})
+		for (bool preopen : {false, true})
+			run(format, preopen);
+
+	return 0;
+}
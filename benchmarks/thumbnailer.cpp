@@ -0,0 +1,72 @@
+#include "bench.hpp"
+#include "thumbnailer.hpp"
+#include <thread>
+
+#define NB_THUMBNAILS 32
+
+static const std::string clip = "/tmp/thumbnailer_bench.mkv";
+
+/*
+ * decoding the whole file, the way it is done without seeking
+ */
+static void sequential()
+{
+	av::input in;
+	av::packet p;
+	av::frame f;
+	int nb_frames = 0;
+
+	if (!in.open(clip))
+		return;
+
+	av::decoder dec = in.get(0);
+	if (!dec)
+		return;
+
+	stopwatch sw;
+
+	while (in >> p) {
+		dec << p;
+		while (dec >> f)
+			nb_frames++;
+	}
+	dec.flush();
+	while (dec >> f)
+		nb_frames++;
+
+	fmt::print("full decode ({} frames): {:.3f}s\n", nb_frames,
+		   sw.wall());
+}
+
+static void run(size_t nb_workers, bool exact)
+{
+	av::thumbnailer thumbnailer(320, "mjpeg", nb_workers);
+
+	thumbnailer.set_exact(exact);
+
+	stopwatch sw;
+
+	auto thumbnails = thumbnailer.extract(clip, NB_THUMBNAILS);
+
+	fmt::print("{:2} workers, {:9}: {:6.1f} thumbnails/s\n", nb_workers,
+		   exact ? "exact" : "keyframes",
+		   thumbnails.size() / sw.wall());
+}
+
+int main()
+{
+	size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+	// 2 minutes at 25 fps, 10s GOP
+	if (!generate_clip(clip, "libx264", 1280, 720, 3000, "g=250"))
+		return 1;
+
+	sequential();
+
+	for (size_t n = 1; n <= cores; n *= 2) {
+		run(n, true);
+		run(n, false);
+	}
+
+	return 0;
+}
@@ -1,16 +1,28 @@
+#include "affinity.hpp"
 #include "ffmpeg.hpp"
+#include "load_shedder.hpp"
 #include "packet_queue.hpp"
+#include <chrono>
 #include <iostream>
 #include <vector>
 
-static void read_stream(packet_queue *q, av::decoder &&decoder)
+static void read_stream(packet_queue *q, av::decoder &&decoder,
+			AVRational frame_rate)
 {
+	av::load_shedder shedder(decoder, frame_rate);
+	av::shed_level level = av::shed_level::none;
 	av::packet p;
 	av::frame f;
 
 	while (!q->is_closed()) {
 		p = q->dequeue();
 
+		// falling behind the source: skip frames rather than lag
+		if (!shedder.admit(p, q->size()))
+			continue;
+
+		auto start = std::chrono::steady_clock::now();
+
 		decoder << p;
 
 		while (decoder >> f) {
@@ -18,6 +30,17 @@ static void read_stream(packet_queue *q, av::decoder &&decoder)
 				  << " on stream: " << p.stream_index()
 				  << std::endl;
 		}
+
+		shedder.decoded(std::chrono::duration<double>(
+				    std::chrono::steady_clock::now() - start)
+				    .count());
+
+		if (shedder.level() != level) {
+			level = shedder.level();
+			std::cerr << "stream " << p.stream_index()
+				  << " shedding level " << (int)level
+				  << std::endl;
+		}
 	}
 
 	std::cerr << "queue is closed" << std::endl;
@@ -31,14 +54,17 @@ int main(int argc, char *argv[])
 	av::packet p;
 
 	if (argc < 2) {
-		std::cerr << "Usage: " << argv[0] << " <multi_stream_video>"
-			  << std::endl;
+		std::cerr << "Usage: " << argv[0]
+			  << " <multi_stream_video> [--pin]" << std::endl;
 		return -1;
 	}
 
 	if (!multi.open(argv[1]))
 		return -1;
 
+	av::placement placement(multi.nb_streams(),
+				argc > 2 && std::string(argv[2]) == "--pin");
+
 	while (multi >> p) {
 		int index = p.stream_index();
 
@@ -51,9 +77,18 @@ int main(int argc, char *argv[])
 		}
 
 		if (!queues[index]) {
+			std::string opts = placement.codec_options(index);
+
+			// decoder and libavcodec threads inherit the pinning
+			placement.pin(index);
+
 			queues[index] = new packet_queue();
 			decoders[index] = std::thread(
-			    read_stream, queues[index], multi.get(index));
+			    read_stream, queues[index],
+			    multi.get(index, "", opts),
+			    multi.frame_rate(index));
+
+			placement.unpin();
 		}
 
 		queues[index]->release(p);
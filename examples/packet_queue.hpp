@@ -53,6 +53,13 @@ struct packet_queue {
 		empty_packets.push_back(p);
 	}
 
+	size_t size()
+	{
+		std::lock_guard<std::mutex> l(m);
+
+		return filled_packets.size();
+	}
+
 	bool is_closed()
 	{
 		std::lock_guard<std::mutex> l(m);
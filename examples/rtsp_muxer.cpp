@@ -1,64 +1,38 @@
-#include <atomic>
-#include <condition_variable>
 #include <iostream>
-#include <list>
-#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include "ffmpeg.hpp"
-#include "packet_queue.hpp"
+#include "interleaver.hpp"
 
-static void read_stream_delta(av::input &in, packet_queue &q, int stream_index,
-			      int64_t delta)
+static void read_stream(av::input &in, av::interleaver &il, int stream_index)
 {
-	std::cerr << "got delta: " << delta << " on stream " << stream_index
-		  << std::endl;
-
-	while (!q.is_closed()) {
-		av::packet p = q.acquire();
-
-		if (!(in >> p))
-			return;
-
-		p.add_delta_pts(delta);
-		p.stream_index(stream_index);
-
-		q.release(p);
-	}
-}
-
-static void read_stream(av::input &in, packet_queue &q, int stream_index)
-{
-	static std::atomic<int64_t> t0(AV_NOPTS_VALUE);
 	av::packet p;
+	bool aligned = false;
 
 	while (in >> p) {
-		int64_t realtime;
+		if (!aligned) {
+			int64_t realtime = in.start_time_realtime();
 
-		realtime = in.start_time_realtime();
+			if (realtime == AV_NOPTS_VALUE)
+				continue;
 
-		if (realtime == AV_NOPTS_VALUE)
-			continue;
+			il.align(stream_index, realtime);
+			aligned = true;
 
-		if (stream_index == 0) {
-			t0 = realtime;
-			return read_stream_delta(in, q, 0, 0);
+			std::cerr << "stream " << stream_index
+				  << " starts at realtime " << realtime
+				  << std::endl;
 		}
-		if (t0 == AV_NOPTS_VALUE)
-			continue;
-
-		// now calculate delta
-		int64_t delta;
-		AVRational time_base;
 
-		time_base = in.time_base(0);
-		delta = av_rescale(realtime - t0, time_base.den,
-				   time_base.num * 1000000);
+		p.stream_index(stream_index);
 
-		return read_stream_delta(in, q, stream_index, delta);
+		if (!il.submit(stream_index, p))
+			break;
 	}
+
+	il.finish(stream_index);
 }
 
 int main(int argc, char *argv[])
@@ -72,7 +46,6 @@ int main(int argc, char *argv[])
 	av::output output;
 	std::vector<av::input> inputs(argc - 2);
 	std::vector<std::thread> reads(argc - 2);
-	packet_queue q;
 
 	if (!output.open(argv[1])) {
 		std::cerr << "Can't open output " << argv[1] << std::endl;
@@ -94,23 +67,16 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	av::interleaver il(output, reads.size());
+
 	for (size_t i = 0; i < reads.size(); i++)
 		reads[i] = std::thread(read_stream, std::ref(inputs[i]),
-				       std::ref(q), i);
-
-	while (1) {
-		av::packet p = q.dequeue();
-
-		if (!(output << p))
-			break;
-
-		q.enqueue(p);
-	}
-
-	q.close();
+				       std::ref(il), i);
 
 	for (size_t i = 0; i < reads.size(); i++)
 		reads[i].join();
 
+	il.close();
+
 	return 0;
 }
@@ -0,0 +1,219 @@
+#include "affinity.hpp"
+#include <algorithm>
+#include <fmt/core.h>
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace av
+{
+
+// from linux/mempolicy.h, libnuma is not needed for a single syscall
+enum { mpol_default = 0, mpol_preferred = 1 };
+
+/*
+ * parse a sysfs cpu list like "0-3,8-11"
+ */
+static std::vector<int> parse_cpulist(const std::string &list)
+{
+	std::vector<int> cpus;
+	std::stringstream ss(list);
+	std::string range;
+
+	while (std::getline(ss, range, ',')) {
+		int first, last;
+
+		if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2)
+			for (int cpu = first; cpu <= last; cpu++)
+				cpus.push_back(cpu);
+		else if (sscanf(range.c_str(), "%d", &first) == 1)
+			cpus.push_back(first);
+	}
+
+	return cpus;
+}
+
+static std::vector<int> allowed_cpus()
+{
+	std::vector<int> cpus;
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+		return cpus;
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET(cpu, &set))
+			cpus.push_back(cpu);
+
+	return cpus;
+}
+
+static bool set_affinity(const std::vector<int> &cpus)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	for (auto cpu : cpus)
+		CPU_SET(cpu, &set);
+
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		fmt::print(stderr, "sched_setaffinity fails\n");
+		return false;
+	}
+	return true;
+}
+
+static bool set_memory_policy(int mode, int node)
+{
+	unsigned long mask = 0;
+
+	if (node >= (int)sizeof(mask) * 8)
+		return false;
+
+	if (mode != mpol_default)
+		mask = 1ul << node;
+
+	return syscall(SYS_set_mempolicy, mode,
+		       mode == mpol_default ? nullptr : &mask,
+		       sizeof(mask) * 8) == 0;
+}
+
+topology::topology()
+{
+	std::vector<int> allowed = allowed_cpus();
+
+	for (int node = 0;; node++) {
+		std::ifstream f(fmt::format(
+		    "/sys/devices/system/node/node{}/cpulist", node));
+		std::vector<int> cpus;
+		std::string list;
+
+		if (!f)
+			break;
+
+		std::getline(f, list);
+
+		for (auto cpu : parse_cpulist(list))
+			if (std::find(allowed.begin(), allowed.end(), cpu) !=
+			    allowed.end())
+				cpus.push_back(cpu);
+
+		nodes.push_back(cpus);
+	}
+
+	// nodes the process can't run on don't matter
+	nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+				   [](auto &cpus) { return cpus.empty(); }),
+		    nodes.end());
+
+	if (nodes.empty())
+		nodes.push_back(allowed);
+}
+
+const topology &topology::machine()
+{
+	static topology t;
+
+	return t;
+}
+
+size_t topology::nb_cpus() const
+{
+	size_t n = 0;
+
+	for (auto &cpus : nodes)
+		n += cpus.size();
+
+	return n;
+}
+
+/*
+ * Spread the sets over the nodes round-robin, then split the CPUs of each
+ * node between its sets. Sets share CPUs only when a node has fewer CPUs
+ * than sets.
+ */
+std::vector<core_set> topology::partition(size_t nb_sets) const
+{
+	std::vector<core_set> sets(nb_sets);
+	std::vector<size_t> per_node(nodes.size(), 0);
+
+	for (size_t i = 0; i < nb_sets; i++)
+		per_node[i % nodes.size()]++;
+
+	for (size_t i = 0; i < nb_sets; i++) {
+		int node = i % nodes.size();
+		const std::vector<int> &cpus = nodes[node];
+		size_t n = per_node[node];
+		size_t rank = i / nodes.size();
+
+		sets[i].node = node;
+
+		if (n > cpus.size()) {
+			sets[i].cpus.push_back(cpus[rank % cpus.size()]);
+			continue;
+		}
+
+		size_t begin = rank * cpus.size() / n;
+		size_t end = (rank + 1) * cpus.size() / n;
+
+		sets[i].cpus.assign(cpus.begin() + begin, cpus.begin() + end);
+	}
+
+	return sets;
+}
+
+placement::placement(size_t nb_streams, bool pinned)
+    : pinned(pinned),
+      sets(topology::machine().partition(std::max<size_t>(nb_streams, 1))),
+      all_cpus(allowed_cpus())
+{
+}
+
+const core_set &placement::get(int stream) const
+{
+	return sets[stream % sets.size()];
+}
+
+bool placement::pin(int stream) const
+{
+	const core_set &set = get(stream);
+
+	if (!pinned)
+		return true;
+
+	if (!set_affinity(set.cpus))
+		return false;
+
+	// best effort: kernels without NUMA support refuse the policy
+	if (topology::machine().nb_nodes() > 1)
+		set_memory_policy(mpol_preferred, set.node);
+
+	return true;
+}
+
+bool placement::unpin() const
+{
+	if (!pinned)
+		return true;
+
+	if (topology::machine().nb_nodes() > 1)
+		set_memory_policy(mpol_default, 0);
+
+	return set_affinity(all_cpus);
+}
+
+std::string placement::codec_options(int stream,
+				     const std::string &options) const
+{
+	if (!pinned || options.find("threads=") != std::string::npos)
+		return options;
+
+	if (options.empty())
+		return fmt::format("threads={}", get(stream).cpus.size());
+
+	return fmt::format("{}:threads={}", options, get(stream).cpus.size());
+}
+
+} // namespace av
@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace av
+{
+
+/*
+ * CPUs of one NUMA node a group of threads is pinned to.
+ */
+struct core_set {
+	std::vector<int> cpus;
+	int node;
+};
+
+/*
+ * NUMA nodes and the CPUs of each the process may run on, from
+ * /sys/devices/system/node. Machines without NUMA information show one
+ * node with every allowed CPU.
+ */
+class topology
+{
+public:
+	static const topology &machine();
+
+	size_t nb_nodes() const { return nodes.size(); }
+	size_t nb_cpus() const;
+	const std::vector<int> &cpus(int node) const { return nodes[node]; }
+
+	std::vector<core_set> partition(size_t nb_sets) const;
+
+private:
+	topology();
+
+	std::vector<std::vector<int>> nodes;
+};
+
+/*
+ * Thread placement for per-stream pipelines: each stream gets a core set
+ * inside one node. pin() binds the calling thread to the stream's CPUs
+ * and makes its allocations prefer the stream's node. Threads inherit the
+ * affinity of the thread creating them, so pinning before opening a
+ * codec keeps libavcodec's own threads on the same CPUs;
+ * codec_options() sizes them to the set. A placement built unpinned
+ * leaves the scheduler alone.
+ */
+class placement
+{
+public:
+	placement(size_t nb_streams, bool pinned = true);
+
+	const core_set &get(int stream) const;
+
+	bool pin(int stream) const;
+	bool unpin() const;
+
+	std::string codec_options(int stream,
+				  const std::string &options = "") const;
+
+private:
+	bool pinned;
+	std::vector<core_set> sets;
+	std::vector<int> all_cpus;
+};
+
+} // namespace av
@@ -0,0 +1,181 @@
+#include "codec_pool.hpp"
+#include <cassert>
+
+namespace av
+{
+
+codec_pool::codec_pool(size_t max_idle)
+    : max_idle(max_idle), nb_hits(0), nb_misses(0)
+{
+}
+
+codec_pool::~codec_pool()
+{
+	for (auto ctx : contexts)
+		avcodec_free_context(&ctx);
+}
+
+// the entry owns its copy of the stream parameters
+std::shared_ptr<codec_pool::entry> codec_pool::make_entry(const entry &key)
+{
+	return std::shared_ptr<entry>(new entry(key), [](entry *e) {
+		avcodec_parameters_free(&e->par);
+		delete e;
+	});
+}
+
+decoder codec_pool::get(input &in, int index, const std::string &codec_name,
+			const std::string &options)
+{
+	AVCodecParameters *key_par;
+	decoder dec;
+	entry key;
+
+	assert((unsigned int)index < in.ctx->nb_streams);
+
+	key_par = in.ctx->streams[index]->codecpar;
+	key = {codec_name, options, key_par, false, AVDISCARD_DEFAULT};
+
+	dec.ctx = take(key, false, dec.pool_key);
+	if (dec.ctx)
+		return dec;
+
+	dec = in.get(index, codec_name, options);
+	if (!dec)
+		return dec;
+
+	key.skip_frame = dec.ctx->skip_frame;
+
+	key.par = avcodec_parameters_alloc();
+	if (!key.par || avcodec_parameters_copy(key.par, key_par) < 0) {
+		avcodec_parameters_free(&key.par);
+		return dec;
+	}
+
+	dec.pool_key = make_entry(key);
+	return dec;
+}
+
+encoder codec_pool::get(output &out, const std::string &codec,
+			const std::string &options)
+{
+	bool global_header = out.ctx->oformat->flags & AVFMT_GLOBALHEADER;
+	entry key = {codec, options, nullptr, global_header,
+		     AVDISCARD_DEFAULT};
+	encoder enc;
+
+	enc.ctx = take(key, true, enc.pool_key);
+	if (!enc.ctx) {
+		enc = out.add_stream(codec, options);
+		if (!enc || !(enc.ctx->codec->capabilities &
+			      AV_CODEC_CAP_ENCODER_FLUSH))
+			return enc;
+
+		enc.pool_key = make_entry(key);
+		return enc;
+	}
+
+	enc.stream_index = out.attach(enc.ctx);
+	if (enc.stream_index < 0)
+		release(std::move(enc));
+
+	return enc;
+}
+
+void codec_pool::release(decoder &&dec)
+{
+	give(dec.ctx, std::move(dec.pool_key));
+	dec.ctx = nullptr;
+}
+
+void codec_pool::release(encoder &&enc)
+{
+	give(enc.ctx, std::move(enc.pool_key));
+	enc.ctx = nullptr;
+	enc.stream_index = -1;
+}
+
+size_t codec_pool::idle() const
+{
+	std::lock_guard<std::mutex> lock(m);
+	return contexts.size();
+}
+
+size_t codec_pool::hits() const
+{
+	std::lock_guard<std::mutex> lock(m);
+	return nb_hits;
+}
+
+size_t codec_pool::misses() const
+{
+	std::lock_guard<std::mutex> lock(m);
+	return nb_misses;
+}
+
+AVCodecContext *codec_pool::take(const entry &key, bool is_encoder,
+				 std::shared_ptr<void> &owner)
+{
+	std::lock_guard<std::mutex> lock(m);
+
+	// the most recently released context first, it is the warmest
+	for (auto it = contexts.rbegin(); it != contexts.rend(); it++) {
+		AVCodecContext *ctx = *it;
+		const entry &e = *keys[ctx];
+
+		if (!!av_codec_is_encoder(ctx->codec) != is_encoder ||
+		    e.name != key.name || e.options != key.options ||
+		    e.global_header != key.global_header)
+			continue;
+
+		if (!is_encoder && !compatible(e.par, key.par))
+			continue;
+
+		ctx->skip_frame = e.skip_frame;
+
+		// the wrapper handed out owns the entry from now on
+		owner = std::move(keys[ctx]);
+		keys.erase(ctx);
+
+		contexts.erase(std::next(it).base());
+		avcodec_flush_buffers(ctx);
+		nb_hits++;
+
+		return ctx;
+	}
+
+	nb_misses++;
+	return nullptr;
+}
+
+void codec_pool::give(AVCodecContext *ctx, std::shared_ptr<void> &&key)
+{
+	if (!ctx)
+		return;
+
+	// not pooled: a context opened elsewhere or an unflushable encoder
+	if (!key) {
+		avcodec_free_context(&ctx);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m);
+
+	keys[ctx] = std::static_pointer_cast<entry>(std::move(key));
+	contexts.push_back(ctx);
+	trim();
+}
+
+void codec_pool::trim()
+{
+	while (contexts.size() > max_idle) {
+		AVCodecContext *ctx = contexts.front();
+
+		contexts.pop_front();
+
+		keys.erase(ctx);
+		avcodec_free_context(&ctx);
+	}
+}
+
+} // namespace av
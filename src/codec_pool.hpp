@@ -0,0 +1,69 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace av
+{
+
+/*
+ * Keeps opened codec contexts around for the next stream with the same
+ * parameters. get() hands back an idle context reset with
+ * avcodec_flush_buffers when codec, options and stream parameters match,
+ * or opens a new one. release() gives a context back, the oldest idle
+ * ones are freed past `max_idle`. Encoders are only pooled when the codec
+ * supports flushing (AV_CODEC_CAP_ENCODER_FLUSH).
+ */
+class codec_pool
+{
+public:
+	explicit codec_pool(size_t max_idle = 16);
+	~codec_pool();
+
+	decoder get(input &in, int index, const std::string &codec_name = "",
+		    const std::string &options = "");
+	encoder get(output &out, const std::string &codec,
+		    const std::string &options = "");
+
+	void release(decoder &&dec);
+	void release(encoder &&enc);
+
+	size_t idle() const;
+	size_t hits() const;
+	size_t misses() const;
+
+private:
+	codec_pool(const codec_pool &) = delete;
+	codec_pool &operator=(const codec_pool &) = delete;
+
+	struct entry {
+		std::string name;
+		std::string options;
+		AVCodecParameters *par;
+		bool global_header;
+		// restored on reuse, load shedding changes it
+		AVDiscard skip_frame;
+	};
+
+	static std::shared_ptr<entry> make_entry(const entry &key);
+
+	AVCodecContext *take(const entry &key, bool is_encoder,
+			     std::shared_ptr<void> &owner);
+	void give(AVCodecContext *ctx, std::shared_ptr<void> &&key);
+	void trim();
+
+	size_t max_idle;
+	size_t nb_hits, nb_misses;
+
+	/*
+	 * entries of the idle contexts, the ones handed out are held by their
+	 * wrapper and go away with it when it is not released
+	 */
+	mutable std::mutex m;
+	std::map<AVCodecContext *, std::shared_ptr<entry>> keys;
+	std::deque<AVCodecContext *> contexts;
+};
+
+} // namespace av
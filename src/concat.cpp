@@ -0,0 +1,642 @@
+#include "concat.hpp"
+#include "negotiation.hpp"
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <thread>
+
+extern "C" {
+#include <libavutil/audio_fifo.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace av
+{
+
+class concatenator
+{
+public:
+	concatenator(output &out, const std::string &options)
+	    : stats(), out(out), options(options)
+	{
+	}
+
+	bool run(const std::vector<std::string> &uris);
+
+	concat_stats stats;
+
+private:
+	struct segment {
+		std::string uri;
+		stream_info info;
+		int64_t start;
+		std::vector<int> map;
+		std::vector<bool> reencode;
+	};
+
+	// output stream, indexed by the stream of the first input
+	struct stream {
+		int index;
+		AVRational tb, frame_rate;
+		int64_t duration;
+		int64_t last_dts;
+		int64_t end;
+		bool inband;
+	};
+
+	// input stream of the segment being copied
+	struct track {
+		track()
+		    : index(-1), delta(0), next_pts(AV_NOPTS_VALUE),
+		      fifo(nullptr)
+		{
+		}
+		~track()
+		{
+			if (fifo)
+				av_audio_fifo_free(fifo);
+		}
+
+		int index;
+		AVRational tb;
+		int64_t delta;
+		int64_t next_pts;
+		decoder dec;
+		encoder enc;
+		std::unique_ptr<converter> conv;
+		bsf_chain annexb;
+		AVAudioFifo *fifo;
+	};
+
+	static std::unique_ptr<input> probe(const std::string &uri);
+	std::unique_ptr<input> open_segment(size_t k);
+
+	bool scan(const std::vector<std::string> &uris);
+	bool analyze(input &in, segment &seg);
+	bool add_streams();
+
+	bool copy(input &in, const segment &seg, bool first_segment);
+	bool push(track &t, packet &p);
+	bool finish(track &t);
+
+	bool open_encoder(track &t);
+	bool encode(track &t);
+	bool send_samples(track &t, int nb_samples);
+	bool drain(track &t);
+
+	bool write(track &t, packet &p, AVRational tb);
+	int64_t end_time() const;
+
+	output &out;
+	std::string options;
+	std::unique_ptr<input> first;
+	std::vector<segment> segments;
+	std::vector<stream> streams;
+	std::vector<std::unique_ptr<track>> tracks;
+};
+
+static const char *annexb_filter(AVCodecID id)
+{
+	if (id == AV_CODEC_ID_H264)
+		return "h264_mp4toannexb";
+	if (id == AV_CODEC_ID_HEVC)
+		return "hevc_mp4toannexb";
+	return nullptr;
+}
+
+bool concatenator::run(const std::vector<std::string> &uris)
+{
+	std::future<std::unique_ptr<input>> next;
+	std::unique_ptr<input> in;
+
+	if (uris.empty()) {
+		fmt::print(stderr, "concat: no input\n");
+		return false;
+	}
+
+	if (!scan(uris) || !add_streams())
+		return false;
+
+	in = std::move(first);
+
+	for (size_t k = 0; k < segments.size(); k++) {
+		bool last = k + 1 == segments.size();
+
+		// opened while the current one is copied, ready at the boundary
+		if (!last)
+			next = std::async(std::launch::async,
+					  &concatenator::open_segment, this,
+					  k + 1);
+
+		if (!copy(*in, segments[k], k == 0))
+			return false;
+
+		if (!last) {
+			in = next.get();
+			if (!in)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+std::unique_ptr<input> concatenator::probe(const std::string &uri)
+{
+	auto in = std::make_unique<input>();
+
+	if (!in->open(uri)) {
+		fmt::print(stderr, "concat: cannot open '{}'\n", uri);
+		return nullptr;
+	}
+
+	return in;
+}
+
+std::unique_ptr<input> concatenator::open_segment(size_t k)
+{
+	const segment &seg = segments[k];
+	auto in = std::make_unique<input>();
+
+	if (!in->open(seg.uri, seg.info)) {
+		fmt::print(stderr, "concat: cannot open '{}'\n", seg.uri);
+		return nullptr;
+	}
+
+	if ((size_t)in->nb_streams() != seg.map.size()) {
+		fmt::print(stderr, "concat: '{}' changed\n", seg.uri);
+		return nullptr;
+	}
+
+	return in;
+}
+
+/*
+ * all the inputs are probed before anything is written: the output streams
+ * depend on whether some parts have to be re-encoded. The stream infos
+ * kept make reopening them cheap.
+ */
+bool concatenator::scan(const std::vector<std::string> &uris)
+{
+	size_t batch = std::max(1u, std::thread::hardware_concurrency());
+
+	segments.resize(uris.size());
+
+	for (size_t k = 0; k < uris.size(); k += batch) {
+		std::vector<std::future<std::unique_ptr<input>>> probes;
+		size_t n = std::min(batch, uris.size() - k);
+
+		for (size_t i = 0; i < n; i++)
+			probes.push_back(std::async(std::launch::async,
+						    &concatenator::probe,
+						    uris[k + i]));
+
+		for (size_t i = 0; i < n; i++) {
+			auto in = probes[i].get();
+
+			if (!in)
+				return false;
+
+			segments[k + i].uri = uris[k + i];
+
+			if (k + i == 0)
+				first = std::move(in);
+			else if (!analyze(*in, segments[k + i]))
+				return false;
+		}
+	}
+
+	return analyze(*first, segments[0]);
+}
+
+/*
+ * the nth stream of a type goes to the nth stream of that type of the first
+ * input, when there is one
+ */
+bool concatenator::analyze(input &in, segment &seg)
+{
+	int count[AVMEDIA_TYPE_NB] = {};
+
+	seg.info = in.get_stream_info();
+	seg.start = in.ctx->start_time != AV_NOPTS_VALUE ? in.ctx->start_time
+							  : 0;
+	seg.map.assign(in.nb_streams(), -1);
+	seg.reencode.assign(in.nb_streams(), false);
+
+	for (int i = 0; i < in.nb_streams(); i++) {
+		const AVCodecParameters *par = in.ctx->streams[i]->codecpar;
+		int n = par->codec_type >= 0 ? count[par->codec_type]++ : -1;
+
+		for (int j = 0; n >= 0 && j < first->nb_streams(); j++) {
+			const AVCodecParameters *ref =
+			    first->ctx->streams[j]->codecpar;
+
+			if (ref->codec_type == par->codec_type && n-- == 0) {
+				seg.map[i] = j;
+				seg.reencode[i] = !compatible(ref, par);
+				break;
+			}
+		}
+
+		if (seg.reencode[i] && par->codec_type != AVMEDIA_TYPE_VIDEO &&
+		    par->codec_type != AVMEDIA_TYPE_AUDIO) {
+			fmt::print(stderr,
+				   "concat: dropping stream {} of '{}'\n", i,
+				   seg.uri);
+			seg.map[i] = -1;
+			seg.reencode[i] = false;
+		}
+	}
+
+	return true;
+}
+
+bool concatenator::add_streams()
+{
+	for (int j = 0; j < first->nb_streams(); j++) {
+		const AVCodecParameters *par = first->ctx->streams[j]->codecpar;
+		AVRational frame_rate = first->frame_rate(j);
+		stream s;
+
+		s.tb = first->time_base(j);
+		s.frame_rate = frame_rate;
+		s.duration = 0;
+		s.last_dts = AV_NOPTS_VALUE;
+		s.end = AV_NOPTS_VALUE;
+		s.inband = false;
+
+		if (par->codec_type == AVMEDIA_TYPE_VIDEO &&
+		    frame_rate.num > 0 && frame_rate.den > 0)
+			s.duration =
+			    av_rescale_q(1, av_inv_q(frame_rate), s.tb);
+
+		// re-encoded parts come with parameter sets of their own
+		for (auto &seg : segments)
+			for (size_t i = 0; i < seg.map.size(); i++)
+				if (seg.map[i] == j && seg.reencode[i] &&
+				    annexb_filter(par->codec_id))
+					s.inband = true;
+
+		if (s.inband)
+			s.index = out.add_stream(*first, j, "");
+		else
+			s.index = out.add_stream(*first, j);
+
+		if (s.index < 0)
+			return false;
+
+		if (s.inband) {
+			AVCodecParameters *out_par =
+			    out.ctx->streams[s.index]->codecpar;
+
+			av_freep(&out_par->extradata);
+			out_par->extradata_size = 0;
+		}
+
+		streams.push_back(s);
+	}
+
+	return true;
+}
+
+/*
+ * the segment starts where the longest stream of the previous ones ends,
+ * the first one at 0
+ */
+bool concatenator::copy(input &in, const segment &seg, bool first_segment)
+{
+	int64_t offset = first_segment ? -seg.start : end_time() - seg.start;
+	packet p;
+
+	tracks.clear();
+	tracks.resize(in.nb_streams());
+
+	for (int i = 0; i < in.nb_streams(); i++) {
+		const AVCodecParameters *par = in.ctx->streams[i]->codecpar;
+		int j = seg.map[i];
+
+		if (j < 0)
+			continue;
+
+		auto t = std::make_unique<track>();
+
+		t->index = j;
+		t->tb = in.time_base(i);
+		t->delta = av_rescale_q(offset, AV_TIME_BASE_Q, streams[j].tb);
+
+		if (seg.reencode[i]) {
+			fmt::print(stderr,
+				   "concat: re-encoding stream {} of '{}'\n",
+				   i, seg.uri);
+
+			t->dec = in.get(i);
+			if (!t->dec)
+				return false;
+		} else if (streams[j].inband &&
+			   !t->annexb.open(annexb_filter(par->codec_id), par,
+					   t->tb))
+			return false;
+
+		tracks[i] = std::move(t);
+	}
+
+	while (in >> p) {
+		size_t i = p.stream_index();
+
+		if (i >= tracks.size() || !tracks[i])
+			continue;
+
+		if (!push(*tracks[i], p))
+			return false;
+	}
+
+	for (auto &t : tracks)
+		if (t && !finish(*t))
+			return false;
+
+	return true;
+}
+
+bool concatenator::push(track &t, packet &p)
+{
+	packet filtered;
+
+	// a decoder is only opened for the streams to re-encode
+	if (!!t.dec) {
+		t.dec << p;
+		return encode(t);
+	}
+
+	if (t.annexb.empty())
+		return write(t, p, t.tb);
+
+	if (!(t.annexb << p))
+		return false;
+
+	while (t.annexb >> filtered)
+		if (!write(t, filtered, t.tb))
+			return false;
+
+	return true;
+}
+
+bool concatenator::finish(track &t)
+{
+	packet p;
+
+	if (!t.dec) {
+		if (t.annexb.empty())
+			return true;
+
+		t.annexb.flush();
+		while (t.annexb >> p)
+			if (!write(t, p, t.tb))
+				return false;
+
+		return true;
+	}
+
+	t.dec.flush();
+	if (!encode(t))
+		return false;
+
+	if (!t.enc)
+		return true;
+
+	if (t.fifo && av_audio_fifo_size(t.fifo) > 0 &&
+	    !send_samples(t, av_audio_fifo_size(t.fifo)))
+		return false;
+
+	t.enc.flush();
+	return drain(t);
+}
+
+/*
+ * an encoder producing the parameters of the output stream, as far as the
+ * codec allows: the ones of the first input
+ */
+bool concatenator::open_encoder(track &t)
+{
+	const stream &s = streams[t.index];
+	const AVCodecParameters *par = out.ctx->streams[s.index]->codecpar;
+	const AVCodec *c = avcodec_find_encoder(par->codec_id);
+	bool global_header = false;
+	std::string opts;
+
+	if (!c) {
+		fmt::print(stderr, "concat: no encoder for {}\n",
+			   avcodec_get_name(par->codec_id));
+		return false;
+	}
+
+	if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+		AVPixelFormat format = (AVPixelFormat)par->format;
+
+		opts = fmt::format(
+		    "video_size={}x{}:pixel_format={}:time_base={}", par->width,
+		    par->height, av_get_pix_fmt_name(format), to_string(s.tb));
+		opts += fmt::format(
+		    ":color_range={}:color_primaries={}:color_trc={}"
+		    ":colorspace={}",
+		    (int)par->color_range, (int)par->color_primaries,
+		    (int)par->color_trc, (int)par->color_space);
+
+		// the rate control can't tell it from a 1/1000 time base
+		if (s.frame_rate.num > 0 && s.frame_rate.den > 0)
+			opts += ":framerate=" + to_string(s.frame_rate);
+		if (par->sample_aspect_ratio.num > 0)
+			opts += ":aspect=" +
+				to_string(par->sample_aspect_ratio);
+	} else {
+		char layout[64];
+
+		av_channel_layout_describe(&par->ch_layout, layout,
+					   sizeof(layout));
+		opts = fmt::format(
+		    "ar={}:ch_layout={}:request_sample_fmt={}:time_base=1/{}",
+		    par->sample_rate, layout,
+		    av_get_sample_fmt_name((AVSampleFormat)par->format),
+		    par->sample_rate);
+	}
+
+	if (par->bit_rate > 0)
+		opts += fmt::format(":b={}", par->bit_rate);
+	if (!options.empty())
+		opts += ":" + options;
+
+	if (!s.inband && (out.ctx->oformat->flags & AVFMT_GLOBALHEADER))
+		global_header = true;
+
+	t.enc = encoder::open(c->name, opts, global_header);
+	if (!t.enc)
+		return false;
+
+	t.conv = std::make_unique<converter>(t.enc);
+
+	// audio encoders mostly take a fixed number of samples per frame
+	if (par->codec_type == AVMEDIA_TYPE_AUDIO) {
+		AVCodecContext *ctx = t.enc.ctx;
+
+		t.fifo = av_audio_fifo_alloc(ctx->sample_fmt,
+					     ctx->ch_layout.nb_channels, 1);
+		if (!t.fifo) {
+			fmt::print(stderr, "concat: cannot allocate fifo\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool concatenator::encode(track &t)
+{
+	frame f;
+
+	while (t.dec >> f) {
+		int64_t pts = f.f->best_effort_timestamp;
+		AVRational enc_tb;
+		frame c;
+
+		if (!t.enc && !open_encoder(t))
+			return false;
+
+		enc_tb = t.enc.ctx->time_base;
+		f.f->pts = AV_NOPTS_VALUE;
+		if (pts != AV_NOPTS_VALUE)
+			f.f->pts = av_rescale_q(pts, t.tb, enc_tb);
+		f.f->pict_type = AV_PICTURE_TYPE_NONE;
+
+		c = t.conv->convert(f);
+
+		if (!t.fifo) {
+			if (!(t.enc << c) || !drain(t))
+				return false;
+			continue;
+		}
+
+		if (t.next_pts == AV_NOPTS_VALUE)
+			t.next_pts = f.f->pts != AV_NOPTS_VALUE ? f.f->pts : 0;
+
+		if (av_audio_fifo_write(t.fifo, (void **)c.f->extended_data,
+					c.f->nb_samples) < c.f->nb_samples) {
+			fmt::print(stderr, "concat: cannot buffer samples\n");
+			return false;
+		}
+
+		int size = t.enc.ctx->frame_size;
+
+		if (!size)
+			size = av_audio_fifo_size(t.fifo);
+
+		while (size > 0 && av_audio_fifo_size(t.fifo) >= size)
+			if (!send_samples(t, size))
+				return false;
+	}
+
+	return true;
+}
+
+bool concatenator::send_samples(track &t, int nb_samples)
+{
+	AVCodecContext *ctx = t.enc.ctx;
+	frame f;
+
+	f.f->format = ctx->sample_fmt;
+	f.f->sample_rate = ctx->sample_rate;
+	f.f->nb_samples = nb_samples;
+	av_channel_layout_copy(&f.f->ch_layout, &ctx->ch_layout);
+
+	if (av_frame_get_buffer(f.f, 0) < 0 ||
+	    av_audio_fifo_read(t.fifo, (void **)f.f->extended_data,
+			       nb_samples) < nb_samples) {
+		fmt::print(stderr, "concat: cannot read samples\n");
+		return false;
+	}
+
+	f.f->pts = t.next_pts;
+	t.next_pts += nb_samples;
+
+	return (t.enc << f) && drain(t);
+}
+
+bool concatenator::drain(track &t)
+{
+	packet p;
+
+	while (t.enc >> p) {
+		if (!write(t, p, t.enc.ctx->time_base))
+			return false;
+		stats.reencoded++;
+	}
+
+	return true;
+}
+
+/*
+ * timestamps of a packet in the time base tb moved to the output stream,
+ * the first dts of a segment can still be at or before the last one of the
+ * previous segment (B-frames, rounding): those are pushed forward
+ */
+bool concatenator::write(track &t, packet &p, AVRational tb)
+{
+	stream &s = streams[t.index];
+	AVPacket *pkt = p.p;
+	int64_t ts;
+
+	av_packet_rescale_ts(pkt, tb, s.tb);
+	pkt->stream_index = s.index;
+
+	if (pkt->pts != AV_NOPTS_VALUE)
+		pkt->pts += t.delta;
+	if (pkt->dts != AV_NOPTS_VALUE)
+		pkt->dts += t.delta;
+
+	if (pkt->dts != AV_NOPTS_VALUE && s.last_dts != AV_NOPTS_VALUE &&
+	    pkt->dts <= s.last_dts) {
+		pkt->dts = s.last_dts + 1;
+		if (pkt->pts != AV_NOPTS_VALUE && pkt->pts < pkt->dts)
+			pkt->pts = pkt->dts;
+	}
+
+	if (pkt->dts != AV_NOPTS_VALUE)
+		s.last_dts = pkt->dts;
+
+	ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+	if (ts != AV_NOPTS_VALUE)
+		s.end = std::max(s.end, ts + (pkt->duration ? pkt->duration
+							    : s.duration));
+
+	stats.packets++;
+	stats.bytes += pkt->size;
+
+	return out << p;
+}
+
+// in AV_TIME_BASE
+int64_t concatenator::end_time() const
+{
+	int64_t end = 0;
+
+	for (auto &s : streams) {
+		if (s.end == AV_NOPTS_VALUE)
+			continue;
+
+		end = std::max(end, av_rescale_q(s.end, s.tb, AV_TIME_BASE_Q));
+	}
+
+	return end;
+}
+
+bool concat(const std::vector<std::string> &uris, output &out,
+	    const std::string &options, concat_stats *stats)
+{
+	concatenator c(out, options);
+	bool ret = c.run(uris);
+
+	if (stats)
+		*stats = c.stats;
+
+	return ret;
+}
+
+} // namespace av
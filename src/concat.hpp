@@ -0,0 +1,27 @@
+#pragma once
+#include "ffmpeg.hpp"
+
+namespace av
+{
+
+struct concat_stats {
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t reencoded;
+};
+
+/*
+ * Joins the inputs one after the other into out, with the streams of the
+ * first input. The streams of the next inputs are matched by type and
+ * order, their timestamps follow the end of the previous input and dts are
+ * kept strictly increasing. Packets are copied, except for the streams
+ * whose codec parameters differ from the first input: these are
+ * re-encoded with the default encoder of the codec and options. All the
+ * inputs are probed first, then each one is reopened in background while
+ * the previous one is copied. h264 and hevc streams with re-encoded parts
+ * carry their parameter sets in band.
+ */
+bool concat(const std::vector<std::string> &uris, output &out,
+	    const std::string &options = "", concat_stats *stats = nullptr);
+
+} // namespace av
@@ -0,0 +1,302 @@
+#include "edit.hpp"
+#include <cmath>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+namespace av
+{
+
+class smart_cutter
+{
+public:
+	smart_cutter(input &in, output &out, const std::string &codec,
+		     const std::string &options)
+	    : stats(), in(in), out(out), codec(codec), options(options),
+	      index(-1), out_index(-1), start(0), end(0), done(false)
+	{
+	}
+
+	bool run(double start_time, double end_time);
+
+	cut_stats stats;
+
+private:
+	bool open_stream();
+	bool open_encoder(encoder &enc, const frame &f);
+	bool flush_gop();
+	bool copy_gop();
+	bool encode_gop();
+	bool write(packet &p);
+
+	input &in;
+	output &out;
+	std::string codec, options;
+	int index, out_index;
+	AVRational tb;
+	int64_t start, end;
+	bool done;
+	decoder dec;
+	bsf_chain annexb;
+	std::vector<packet> gop;
+};
+
+bool smart_cutter::run(double start_time, double end_time)
+{
+	packet p;
+
+	index = in.get_video_index();
+	if (index < 0) {
+		fmt::print(stderr, "smart_cut: no video stream\n");
+		return false;
+	}
+
+	tb = in.time_base(index);
+	start = in.start_time(index) + std::llround(start_time / av_q2d(tb));
+	end = in.start_time(index) + std::llround(end_time / av_q2d(tb));
+	if (end <= start) {
+		fmt::print(stderr, "smart_cut: empty range\n");
+		return false;
+	}
+
+	if (!open_stream())
+		return false;
+
+	dec = in.get(index);
+	if (!dec)
+		return false;
+
+	if (!in.seek(index, start))
+		return false;
+
+	while (!done && in >> p) {
+		if (p.stream_index() != index)
+			continue;
+
+		if (p.is_keyframe() && !gop.empty() && !flush_gop())
+			return false;
+
+		gop.push_back(p);
+	}
+
+	if (!done && !gop.empty() && !flush_gop())
+		return false;
+
+	return true;
+}
+
+/*
+ * a copy of the input stream, without a bitstream filter on the output
+ * side: only the copied packets need one
+ */
+bool smart_cutter::open_stream()
+{
+	const AVCodecParameters *par = in.ctx->streams[index]->codecpar;
+	std::string names;
+
+	if (par->codec_id == AV_CODEC_ID_H264)
+		names = "h264_mp4toannexb";
+	else if (par->codec_id == AV_CODEC_ID_HEVC)
+		names = "hevc_mp4toannexb";
+
+	out_index = out.add_stream(in, index, "");
+	if (out_index < 0)
+		return false;
+
+	if (names.empty())
+		return true;
+
+	// parameter sets in band, both the encoder's and the input ones
+	AVCodecParameters *out_par = out.ctx->streams[out_index]->codecpar;
+
+	av_freep(&out_par->extradata);
+	out_par->extradata_size = 0;
+
+	return annexb.open(names, par, tb);
+}
+
+bool smart_cutter::open_encoder(encoder &enc, const frame &f)
+{
+	const AVCodecParameters *par = in.ctx->streams[index]->codecpar;
+	AVRational frame_rate = in.frame_rate(index);
+	const AVCodec *c = nullptr;
+	std::string opts;
+
+	if (codec.empty())
+		c = avcodec_find_encoder(par->codec_id);
+	else
+		c = avcodec_find_encoder_by_name(codec.c_str());
+
+	if (!c) {
+		fmt::print(stderr, "smart_cut: no encoder\n");
+		return false;
+	}
+
+	/*
+	 * no B-frames: packets come out in order and their dts can follow
+	 * the ones of the copied GOPs
+	 */
+	opts = fmt::format("video_size={}x{}:pixel_format={}:time_base={}:bf=0",
+			   f.f->width, f.f->height,
+			   av_get_pix_fmt_name((AVPixelFormat)f.f->format),
+			   to_string(tb));
+
+	// the re-encoded GOPs look like the copied ones
+	opts += fmt::format(":color_range={}:color_primaries={}:color_trc={}"
+			    ":colorspace={}",
+			    (int)par->color_range, (int)par->color_primaries,
+			    (int)par->color_trc, (int)par->color_space);
+	if (par->sample_aspect_ratio.num > 0)
+		opts += ":aspect=" + to_string(par->sample_aspect_ratio);
+	if (frame_rate.num > 0 && frame_rate.den > 0)
+		opts += ":framerate=" + to_string(frame_rate);
+
+	if (!options.empty())
+		opts += ":" + options;
+	else if (par->bit_rate > 0)
+		opts += fmt::format(":b={}", par->bit_rate);
+
+	enc = encoder::open(c->name, opts, false);
+	return !!enc;
+}
+
+/*
+ * the GOP read so far is complete: copied when all of it is in range,
+ * re-encoded when cut, skipped when out of range
+ */
+bool smart_cutter::flush_gop()
+{
+	int64_t min_pts = INT64_MAX, max_pts = INT64_MIN;
+	bool ret = true;
+
+	for (auto &p : gop) {
+		min_pts = std::min(min_pts, p.pts());
+		max_pts = std::max(max_pts, p.pts());
+	}
+
+	if (min_pts >= end)
+		done = true;
+	else if (min_pts >= start && max_pts < end)
+		ret = copy_gop();
+	else if (max_pts >= start)
+		ret = encode_gop();
+
+	gop.clear();
+	return ret;
+}
+
+bool smart_cutter::copy_gop()
+{
+	packet filtered;
+
+	for (auto &p : gop) {
+		if (annexb.empty()) {
+			packet copy = p;
+
+			if (!write(copy))
+				return false;
+			continue;
+		}
+
+		if (!(annexb << p))
+			return false;
+
+		while (annexb >> filtered)
+			if (!write(filtered))
+				return false;
+	}
+
+	stats.copied += gop.size();
+	return true;
+}
+
+bool smart_cutter::encode_gop()
+{
+	AVPacket *key = gop[0].p;
+	bool has_dts = key->pts != AV_NOPTS_VALUE && key->dts != AV_NOPTS_VALUE;
+	encoder enc;
+	frame f;
+	packet p;
+
+	/*
+	 * the dts of the encoded packets lag as much as in the input, or are
+	 * left to the muxer like the input ones
+	 */
+	auto drain = [&]() {
+		while (enc >> p) {
+			p.p->dts = has_dts ? p.p->pts - (key->pts - key->dts)
+					   : AV_NOPTS_VALUE;
+			if (!write(p))
+				return false;
+			stats.encoded++;
+		}
+		return true;
+	};
+
+	auto encode = [&]() {
+		while (dec >> f) {
+			int64_t pts = f.f->best_effort_timestamp;
+
+			if (pts < start || pts >= end)
+				continue;
+
+			if (!enc && !open_encoder(enc, f))
+				return false;
+
+			f.f->pts = pts;
+			f.f->pict_type = AV_PICTURE_TYPE_NONE;
+
+			if (!(enc << f) || !drain())
+				return false;
+		}
+		return true;
+	};
+
+	dec.reset();
+
+	for (auto &pkt : gop) {
+		dec << pkt;
+		if (!encode())
+			return false;
+	}
+
+	dec.flush();
+	if (!encode())
+		return false;
+
+	if (!enc)
+		return true;
+
+	enc.flush();
+	return drain();
+}
+
+bool smart_cutter::write(packet &p)
+{
+	AVPacket *pkt = p.p;
+
+	pkt->stream_index = out_index;
+
+	if (pkt->pts != AV_NOPTS_VALUE)
+		pkt->pts -= start;
+	if (pkt->dts != AV_NOPTS_VALUE)
+		pkt->dts -= start;
+
+	return out << p;
+}
+
+bool smart_cut(input &in, output &out, double start, double end,
+	       const std::string &codec, const std::string &options,
+	       cut_stats *stats)
+{
+	smart_cutter cutter(in, out, codec, options);
+	bool ret = cutter.run(start, end);
+
+	if (stats)
+		*stats = cutter.stats;
+
+	return ret;
+}
+
+} // namespace av
@@ -0,0 +1,26 @@
+#pragma once
+#include "ffmpeg.hpp"
+
+namespace av
+{
+
+struct cut_stats {
+	uint64_t copied;
+	uint64_t encoded;
+};
+
+/*
+ * Frame accurate trim of the first video stream of in to [start, end)
+ * seconds, written to a new stream of out with timestamps starting at 0.
+ * Only the GOPs a boundary falls in are decoded and re-encoded, with
+ * codec (the default encoder of the stream codec when empty) and options
+ * (quality settings...), the GOPs in between are stream-copied. GOPs must
+ * be closed. h264 and hevc parameter sets are carried in band, as the
+ * re-encoded GOPs have their own: the output format must allow it (mpegts,
+ * mp4). Other streams are not copied.
+ */
+bool smart_cut(input &in, output &out, double start, double end,
+	       const std::string &codec = "", const std::string &options = "",
+	       cut_stats *stats = nullptr);
+
+} // namespace av
@@ -0,0 +1,85 @@
+#include "fanout.hpp"
+
+namespace av
+{
+
+fanout::branch::branch(encoder &&e, output &o, std::mutex &l,
+		       size_t queue_size)
+    : enc(std::move(e)), out(o), lock(l),
+      scaler(enc.ctx->pix_fmt, enc.ctx->width, enc.ctx->height),
+      queue(queue_size)
+{
+}
+
+void fanout::branch::run()
+{
+	AVCodecContext *ctx = enc.ctx;
+	frame f;
+	packet p;
+
+	while (queue.pop(f)) {
+		if (f.f->format != ctx->pix_fmt || f.f->width != ctx->width ||
+		    f.f->height != ctx->height) {
+			frame scaled = scaler.scale(f);
+
+			scaled.f->pts = f.f->pts;
+			f = std::move(scaled);
+		}
+
+		if (!(enc << f)) {
+			queue.close(true);
+			break;
+		}
+
+		std::lock_guard<std::mutex> l(lock);
+
+		while (enc >> p)
+			out << p;
+	}
+
+	enc.flush();
+
+	std::lock_guard<std::mutex> l(lock);
+
+	while (enc >> p)
+		out << p;
+}
+
+bool fanout::add_branch(encoder &&enc, output &out)
+{
+	if (!enc)
+		return false;
+
+	auto &lock = locks[&out];
+	if (!lock)
+		lock = std::make_unique<std::mutex>();
+
+	branches.push_back(
+	    std::make_unique<branch>(std::move(enc), out, *lock, queue_size));
+
+	branch *b = branches.back().get();
+	b->worker = std::thread(&branch::run, b);
+	return true;
+}
+
+bool fanout::operator<<(const frame &f)
+{
+	bool ret = true;
+
+	for (auto &b : branches)
+		ret &= b->queue.push(f);
+
+	return ret;
+}
+
+void fanout::flush()
+{
+	for (auto &b : branches)
+		b->queue.close();
+
+	for (auto &b : branches)
+		if (b->worker.joinable())
+			b->worker.join();
+}
+
+} // namespace av
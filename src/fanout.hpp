@@ -0,0 +1,55 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include "queue.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace av
+{
+
+/*
+ * Decode once, encode many: every frame pushed is shared by reference with
+ * all the branches. Each branch runs on its own thread, scales the frame to
+ * its encoder format (no copy when it already matches) and writes the
+ * packets to its output. Branches sharing an output are serialized.
+ */
+class fanout
+{
+public:
+	fanout(size_t queue_size = 4) : queue_size(queue_size) {}
+	~fanout() { flush(); }
+
+	bool add_branch(encoder &&enc, output &out);
+
+	bool operator<<(const frame &f);
+	void flush();
+
+	size_t size() const { return branches.size(); }
+
+private:
+	fanout(const fanout &) = delete;
+	fanout &operator=(const fanout &) = delete;
+
+	struct branch {
+		branch(encoder &&enc, output &out, std::mutex &lock,
+		       size_t queue_size);
+
+		void run();
+
+		encoder enc;
+		output &out;
+		std::mutex &lock;
+		frame::scaler scaler;
+		bounded_queue<frame> queue;
+		std::thread worker;
+	};
+
+	size_t queue_size;
+	std::vector<std::unique_ptr<branch>> branches;
+	std::map<output *, std::unique_ptr<std::mutex>> locks;
+};
+
+} // namespace av
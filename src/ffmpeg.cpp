@@ -1,5 +1,9 @@
 #include "ffmpeg.hpp"
+#include "memory_budget.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <fmt/core.h>
 #include <iostream>
 #include <map>
@@ -7,7 +11,9 @@
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavutil/opt.h>
+#include <libavutil/parseutils.h>
 #include <libavutil/pixdesc.h>
+#include <libswresample/swresample.h>
 #include <libswscale/swscale.h>
 }
 
@@ -23,6 +29,20 @@ static std::string dictionary_to_string(const AVDictionary *d)
 	return ret;
 }
 
+/*
+ * options are applied in order, so the ones given by the user override the
+ * defaults
+ */
+static std::string merge_options(const std::string &defaults,
+				 const std::string &options)
+{
+	if (defaults.empty())
+		return options;
+	if (options.empty())
+		return defaults;
+	return defaults + ":" + options;
+}
+
 struct dictionary {
 	AVDictionary *d;
 
@@ -43,9 +63,23 @@ struct dictionary {
 	AVDictionary **ptr() { return &d; }
 };
 
+static std::string ffmpeg_probe_options(av::probe mode)
+{
+	switch (mode) {
+	case av::probe::fast:
+		return "probesize=500000:analyzeduration=500000:fpsprobesize=5";
+	case av::probe::minimal:
+		// an analyzeduration of 0 is the default one, not none
+		return "probesize=32:analyzeduration=1:fpsprobesize=0";
+	default:
+		return "";
+	}
+}
+
 static AVFormatContext *ffmpeg_input_format_context(const std::string &uri,
 						    const std::string &format,
-						    const std::string &options)
+						    const std::string &options,
+						    bool find_info = true)
 {
 	AVFormatContext *fmt_ctx = nullptr;
 	const AVInputFormat *ifmt = nullptr;
@@ -67,7 +101,7 @@ static AVFormatContext *ffmpeg_input_format_context(const std::string &uri,
 		return nullptr;
 	}
 
-	if (avformat_find_stream_info(fmt_ctx, NULL) < 0) {
+	if (find_info && avformat_find_stream_info(fmt_ctx, NULL) < 0) {
 		fmt::print(stderr, "Cannot find input stream infos\n");
 		avformat_close_input(&fmt_ctx);
 		return nullptr;
@@ -77,13 +111,22 @@ static AVFormatContext *ffmpeg_input_format_context(const std::string &uri,
 	return fmt_ctx;
 }
 
-static AVFormatContext *ffmpeg_output_format_context(const std::string &uri)
+static AVFormatContext *ffmpeg_output_format_context(const std::string &uri,
+						     const std::string &format)
 {
 	AVFormatContext *format_ctx = nullptr;
 	const AVOutputFormat *oformat = nullptr;
 	const char *ofmt = nullptr;
 
-	oformat = av_guess_format(nullptr, uri.c_str(), nullptr);
+	if (!format.empty()) {
+		oformat = av_guess_format(format.c_str(), nullptr, nullptr);
+		if (!oformat) {
+			fmt::print(stderr, "Cannot find output format '{}'\n",
+				   format);
+			return nullptr;
+		}
+	} else
+		oformat = av_guess_format(nullptr, uri.c_str(), nullptr);
 	if (!oformat) {
 		ofmt = "mpegts";
 		fmt::print(
@@ -101,6 +144,34 @@ static AVFormatContext *ffmpeg_output_format_context(const std::string &uri)
 	return format_ctx;
 }
 
+/*
+ * bitstream filters a muxer needs for a stream copied from another
+ * container
+ */
+static std::string ffmpeg_required_bsfs(const AVOutputFormat *oformat,
+					const AVCodecParameters *par)
+{
+	static const std::vector<std::string> annexb = {"mpegts", "h264",
+							"hevc"};
+	static const std::vector<std::string> asc = {
+	    "mp4", "mov", "ipod", "ismv", "flv", "matroska"};
+	std::string name = oformat->name;
+	bool is_annexb = std::find(annexb.begin(), annexb.end(), name) !=
+			 annexb.end();
+	bool is_asc = std::find(asc.begin(), asc.end(), name) != asc.end();
+	bool mp4_extradata = par->extradata_size > 0 && par->extradata[0] == 1;
+
+	if (is_annexb && mp4_extradata && par->codec_id == AV_CODEC_ID_H264)
+		return "h264_mp4toannexb";
+	if (is_annexb && mp4_extradata && par->codec_id == AV_CODEC_ID_HEVC)
+		return "hevc_mp4toannexb";
+	if (is_asc && par->codec_id == AV_CODEC_ID_AAC &&
+	    par->extradata_size == 0)
+		return "aac_adtstoasc";
+
+	return "";
+}
+
 static AVBufferRef *ffmpeg_hw_context(enum AVHWDeviceType type,
 				      const std::string &device)
 {
@@ -258,6 +329,19 @@ static AVCodecContext *ffmpeg_encoder_context(const std::string &codec_name,
 
 	auto d = dictionary(options);
 
+	/*
+	 * not an option of the codec context: the rate control needs it when
+	 * the time base is not the frame interval
+	 */
+	const AVDictionaryEntry *e = av_dict_get(*d.ptr(), "framerate",
+						 nullptr, 0);
+	if (e) {
+		if (av_parse_video_rate(&codec_ctx->framerate, e->value) < 0)
+			fmt::print(stderr, "Invalid framerate '{}'\n",
+				   e->value);
+		av_dict_set(d.ptr(), "framerate", nullptr, 0);
+	}
+
 	av_opt_set_dict(codec_ctx, d.ptr());
 	av_opt_set_dict(codec_ctx->priv_data, d.ptr());
 
@@ -301,6 +385,71 @@ std::string to_string(const AVRational &r)
 	return fmt::format("{:d}/{:d}", r.num, r.den);
 }
 
+/*
+ * the stream parameters a decoder is opened with and does not take again
+ * from the bitstream
+ */
+bool compatible(const AVCodecParameters *a, const AVCodecParameters *b)
+{
+	if (a->codec_type != b->codec_type || a->codec_id != b->codec_id ||
+	    a->codec_tag != b->codec_tag || a->format != b->format ||
+	    a->profile != b->profile)
+		return false;
+
+	if (a->width != b->width || a->height != b->height)
+		return false;
+
+	if (a->sample_rate != b->sample_rate ||
+	    a->block_align != b->block_align ||
+	    a->bits_per_coded_sample != b->bits_per_coded_sample ||
+	    av_channel_layout_compare(&a->ch_layout, &b->ch_layout) != 0)
+		return false;
+
+	if (a->extradata_size != b->extradata_size)
+		return false;
+
+	return a->extradata_size == 0 ||
+	       !memcmp(a->extradata, b->extradata, a->extradata_size);
+}
+
+std::string low_latency::input_options(const std::string &uri,
+				       const std::string &options)
+{
+	std::string defaults = "fflags=+nobuffer:max_delay=0";
+
+	// only the RTP based demuxers have a reordering buffer
+	if (uri.starts_with("rtsp://") || uri.starts_with("rtp://"))
+		defaults += ":reorder_queue_size=0";
+
+	return merge_options(defaults, options);
+}
+
+std::string low_latency::decoder_options(const std::string &options)
+{
+	return merge_options("flags=+low_delay:thread_type=slice", options);
+}
+
+std::string low_latency::encoder_options(const std::string &codec,
+					 const std::string &options)
+{
+	static const std::map<std::string, std::string> profiles = {
+	    {"libx264", "tune=zerolatency:bf=0:intra-refresh=1"},
+	    {"libx265", "tune=zerolatency:bf=0:x265-params=intra-refresh=1"},
+	    {"h264_nvenc", "tune=ull:zerolatency=1:delay=0:bf=0"},
+	    {"hevc_nvenc", "tune=ull:zerolatency=1:delay=0:bf=0"},
+	};
+	const AVCodec *c = avcodec_find_encoder_by_name(codec.c_str());
+	auto profile = profiles.find(codec);
+
+	if (c && c->type != AVMEDIA_TYPE_VIDEO)
+		return options;
+
+	if (profile == profiles.end())
+		return merge_options("bf=0", options);
+
+	return merge_options(profile->second, options);
+}
+
 packet::packet() : p(av_packet_alloc()) {}
 packet::~packet() { av_packet_free(&p); }
 
@@ -336,10 +485,22 @@ int packet::stream_index() const { return p->stream_index; }
 
 void packet::stream_index(int index) { p->stream_index = index; }
 
+int64_t packet::pts() const { return p->pts; }
+
+int64_t packet::dts() const { return p->dts; }
+
+int packet::size() const { return p->size; }
+
+const uint8_t *packet::data() const { return p->data; }
+
+bool packet::is_keyframe() const { return p->flags & AV_PKT_FLAG_KEY; }
+
 void packet::add_delta_pts(int64_t delta)
 {
-	p->pts += delta;
-	p->dts += delta;
+	if (p->pts != AV_NOPTS_VALUE)
+		p->pts += delta;
+	if (p->dts != AV_NOPTS_VALUE)
+		p->dts += delta;
 }
 
 frame::frame() : f(av_frame_alloc()) {}
@@ -442,6 +603,58 @@ frame frame::scaler::scale(const frame &f)
 	return scaled;
 }
 
+frame::resampler::resampler(AVSampleFormat format, int sample_rate,
+			    const AVChannelLayout &layout)
+    : ctx(nullptr), fmt(format), src_fmt(AV_SAMPLE_FMT_NONE),
+      rate(sample_rate), src_rate(0), layout(), src_layout()
+{
+	av_channel_layout_copy(&this->layout, &layout);
+}
+
+frame::resampler::~resampler()
+{
+	swr_free(&ctx);
+	av_channel_layout_uninit(&layout);
+	av_channel_layout_uninit(&src_layout);
+}
+
+frame frame::resampler::resample(const frame &f)
+{
+	frame resampled;
+
+	if (ctx && (src_fmt != f.f->format || src_rate != f.f->sample_rate ||
+		    av_channel_layout_compare(&src_layout, &f.f->ch_layout)))
+		swr_free(&ctx);
+
+	if (!ctx) {
+		src_fmt = (AVSampleFormat)f.f->format;
+		src_rate = f.f->sample_rate;
+		av_channel_layout_uninit(&src_layout);
+		av_channel_layout_copy(&src_layout, &f.f->ch_layout);
+
+		if (swr_alloc_set_opts2(&ctx, &layout, fmt, rate, &src_layout,
+					src_fmt, src_rate, 0, nullptr) < 0 ||
+		    swr_init(ctx) < 0) {
+			fmt::print(stderr, "swr context allocation fails\n");
+			swr_free(&ctx);
+			return resampled;
+		}
+
+		fmt::print(stderr, "swr context: {} {}Hz → {} {}Hz\n",
+			   av_get_sample_fmt_name(src_fmt), src_rate,
+			   av_get_sample_fmt_name(fmt), rate);
+	}
+
+	resampled.f->format = fmt;
+	resampled.f->sample_rate = rate;
+	av_channel_layout_copy(&resampled.f->ch_layout, &layout);
+
+	if (swr_convert_frame(ctx, resampled.f, f.f) < 0)
+		av_frame_unref(resampled.f);
+
+	return resampled;
+}
+
 hw_frames::~hw_frames() { av_buffer_unref(&ctx); }
 
 hw_frames::hw_frames(const hw_frames &o)
@@ -550,6 +763,7 @@ codec::~codec() { drop(); }
 codec::codec(codec &&o)
 {
 	ctx = o.ctx;
+	pool_key = std::move(o.pool_key);
 	o.ctx = nullptr;
 }
 
@@ -558,6 +772,7 @@ codec &codec::operator=(codec &&o)
 	if (ctx != o.ctx) {
 		drop();
 		ctx = o.ctx;
+		pool_key = std::move(o.pool_key);
 		o.ctx = nullptr;
 	}
 	return *this;
@@ -565,7 +780,11 @@ codec &codec::operator=(codec &&o)
 
 bool codec::operator!() { return (ctx == nullptr); }
 
-void codec::drop() { avcodec_free_context(&ctx); }
+void codec::drop()
+{
+	avcodec_free_context(&ctx);
+	pool_key.reset();
+}
 
 bool decoder::send(const AVPacket *p)
 {
@@ -592,9 +811,29 @@ bool decoder::operator<<(const packet &p) { return send(p.p); }
 bool decoder::operator>>(frame &f)
 {
 	av_frame_unref(f.f);
-	return receive(f.f);
+
+	while (receive(f.f)) {
+		if (!budget || budget->charge(f.f))
+			return true;
+
+		av_frame_unref(f.f);
+	}
+	return false;
 }
 
+/*
+ * drop the buffered frames and leave draining mode, after a seek or a flush
+ */
+void decoder::reset() { avcodec_flush_buffers(ctx); }
+
+/*
+ * frames the decoder skips, AVDISCARD_NONREF or AVDISCARD_NONKEY to save
+ * decoding time
+ */
+void decoder::discard(AVDiscard level) { ctx->skip_frame = level; }
+
+void decoder::set_budget(memory_budget *budget) { this->budget = budget; }
+
 hw_frames decoder::get_hw_frames()
 {
 	hw_frames ret;
@@ -609,10 +848,86 @@ hw_frames decoder::get_hw_frames()
 	return ret;
 }
 
+stream_info::~stream_info() { clear(); }
+
+stream_info::stream_info(const stream_info &o) { *this = o; }
+
+stream_info &stream_info::operator=(const stream_info &o)
+{
+	if (this == &o)
+		return *this;
+
+	clear();
+
+	for (auto par : o.params) {
+		AVCodecParameters *copy = avcodec_parameters_alloc();
+
+		avcodec_parameters_copy(copy, par);
+		params.push_back(copy);
+	}
+	frame_rates = o.frame_rates;
+	return *this;
+}
+
+stream_info::stream_info(stream_info &&o)
+{
+	params.swap(o.params);
+	frame_rates.swap(o.frame_rates);
+}
+
+stream_info &stream_info::operator=(stream_info &&o)
+{
+	if (this != &o) {
+		clear();
+		params.swap(o.params);
+		frame_rates.swap(o.frame_rates);
+	}
+	return *this;
+}
+
+bool stream_info::apply(AVFormatContext *fmt_ctx) const
+{
+	if (params.size() != fmt_ctx->nb_streams)
+		return false;
+
+	for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+		AVCodecParameters *par = fmt_ctx->streams[i]->codecpar;
+
+		if (par->codec_id != AV_CODEC_ID_NONE &&
+		    par->codec_id != params[i]->codec_id)
+			return false;
+	}
+
+	for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+		AVStream *stream = fmt_ctx->streams[i];
+
+		if (avcodec_parameters_copy(stream->codecpar, params[i]) < 0)
+			return false;
+
+		if (stream->avg_frame_rate.num == 0)
+			stream->avg_frame_rate = frame_rates[i];
+	}
+
+	return true;
+}
+
+void stream_info::clear()
+{
+	for (auto &par : params)
+		avcodec_parameters_free(&par);
+
+	params.clear();
+	frame_rates.clear();
+}
+
 input::input(input &&o)
 {
 	ctx = o.ctx;
+	budget = o.budget;
+	shedding = std::move(o.shedding);
+
 	o.ctx = nullptr;
+	o.budget = nullptr;
 }
 
 input &input::operator=(input &&o)
@@ -620,7 +935,11 @@ input &input::operator=(input &&o)
 	if (ctx != o.ctx) {
 		close();
 		ctx = o.ctx;
+		budget = o.budget;
+		shedding = std::move(o.shedding);
+
 		o.ctx = nullptr;
+		o.budget = nullptr;
 	}
 	return *this;
 }
@@ -630,16 +949,72 @@ bool input::open(const std::string &uri, const std::string &options)
 	return open_format(uri, "", options);
 }
 
+bool input::open(const std::string &uri, probe mode,
+		 const std::string &options)
+{
+	return open_format(uri, "", options, mode);
+}
+
+bool input::open(const std::string &uri, const stream_info &info,
+		 const std::string &options)
+{
+	std::string opts;
+
+	close();
+
+	if (info.empty())
+		return open(uri, options);
+
+	opts = merge_options(ffmpeg_probe_options(probe::minimal), options);
+
+	ctx = ffmpeg_input_format_context(uri, "", opts, false);
+	if (!ctx)
+		return false;
+
+	/*
+	 * formats without a header (mpegts) create their streams from the
+	 * first packets: read just enough of them, the cached parameters
+	 * then replace the ones found there
+	 */
+	if ((ctx->ctx_flags & AVFMTCTX_NOHEADER) &&
+	    avformat_find_stream_info(ctx, nullptr) < 0) {
+		fmt::print(stderr, "Cannot find input streams\n");
+		close();
+		return false;
+	}
+
+	if (info.apply(ctx))
+		return true;
+
+	// the streams changed: probe them again, with the usual limits
+	return open(uri, options);
+}
+
 bool input::open_format(const std::string &uri, const std::string &format,
-			const std::string &options)
+			const std::string &options, probe mode)
 {
 	close();
 
-	ctx = ffmpeg_input_format_context(uri, format, options);
+	ctx = ffmpeg_input_format_context(
+	    uri, format, merge_options(ffmpeg_probe_options(mode), options));
 
 	return (ctx != nullptr);
 }
 
+stream_info input::get_stream_info() const
+{
+	stream_info info;
+
+	for (unsigned int i = 0; i < ctx->nb_streams; i++) {
+		AVCodecParameters *par = avcodec_parameters_alloc();
+
+		avcodec_parameters_copy(par, ctx->streams[i]->codecpar);
+		info.params.push_back(par);
+		info.frame_rates.push_back(ctx->streams[i]->avg_frame_rate);
+	}
+	return info;
+}
+
 void input::close() { avformat_close_input(&ctx); }
 
 int input::read(AVPacket *packet) { return av_read_frame(ctx, packet); }
@@ -647,9 +1022,51 @@ int input::read(AVPacket *packet) { return av_read_frame(ctx, packet); }
 bool input::operator>>(packet &p)
 {
 	av_packet_unref(p.p);
-	return !(read(p.p) < 0);
+
+	while (!(read(p.p) < 0)) {
+		unsigned int index = p.p->stream_index;
+
+		if (!budget)
+			return true;
+
+		if (shedding.size() <= index)
+			shedding.resize(index + 1);
+
+		// past a shed packet, restart the stream on a keyframe
+		if (!shedding[index] || (p.p->flags & AV_PKT_FLAG_KEY)) {
+			shedding[index] = !budget->charge(p.p);
+			if (!shedding[index])
+				return true;
+		}
+
+		av_packet_unref(p.p);
+	}
+	return false;
 }
 
+/*
+ * move to the keyframe at or before timestamp, in the time base of the
+ * stream index
+ */
+bool input::seek(int index, int64_t timestamp)
+{
+	assert((unsigned int)index < ctx->nb_streams);
+
+	if (av_seek_frame(ctx, index, timestamp, AVSEEK_FLAG_BACKWARD) < 0)
+		return false;
+
+	shedding.clear();
+	return true;
+}
+
+void input::set_budget(memory_budget *budget)
+{
+	this->budget = budget;
+	shedding.clear();
+}
+
+int input::nb_streams() const { return ctx->nb_streams; }
+
 int input::get_video_index(int id) const
 {
 	return av_find_best_stream(ctx, AVMEDIA_TYPE_VIDEO, id, -1, nullptr, 0);
@@ -709,6 +1126,34 @@ AVRational input::time_base(int index) const
 	return ctx->streams[index]->time_base;
 }
 
+int64_t input::start_time(int index) const
+{
+	assert((unsigned int)index < ctx->nb_streams);
+
+	int64_t start = ctx->streams[index]->start_time;
+
+	return start == AV_NOPTS_VALUE ? 0 : start;
+}
+
+/*
+ * in the time base of the stream, from the container duration when the
+ * stream has none
+ */
+int64_t input::duration(int index) const
+{
+	assert((unsigned int)index < ctx->nb_streams);
+
+	AVStream *st = ctx->streams[index];
+
+	if (st->duration != AV_NOPTS_VALUE)
+		return st->duration;
+
+	if (ctx->duration == AV_NOPTS_VALUE)
+		return 0;
+
+	return av_rescale_q(ctx->duration, AV_TIME_BASE_Q, st->time_base);
+}
+
 std::string input::metadata() const
 {
 	return dictionary_to_string(ctx->metadata);
@@ -730,10 +1175,30 @@ std::string input::stream_metadata(int index) const
 
 bool encoder::send(const AVFrame *frame)
 {
+	AVFrame *key = nullptr;
 	int ret;
 
+	// keyframes asked by reconfigure(), set on a new reference to the frame
+	if (frame && (force_key || (gop && since_key >= gop))) {
+		key = av_frame_clone(frame);
+		if (!key)
+			return false;
+
+		key->pict_type = AV_PICTURE_TYPE_I;
+		frame = key;
+
+		force_key = false;
+		since_key = 0;
+	}
+
+	if (frame) {
+		since_key++;
+		delayed++;
+	}
+
 	ret = avcodec_send_frame(ctx, frame);
 
+	av_frame_free(&key);
 	return !(ret < 0);
 }
 
@@ -747,7 +1212,18 @@ bool encoder::receive(AVPacket *packet)
 
 	packet->stream_index = stream_index;
 
-	return !(ret < 0);
+	if (ret < 0)
+		return false;
+
+	/*
+	 * any keyframe restarts the interval of g, the encoder's own ones
+	 * too: the frames sent after it are the ones still in the encoder
+	 */
+	delayed = std::max(delayed - 1, 0);
+	if (packet->flags & AV_PKT_FLAG_KEY)
+		since_key = delayed + 1;
+
+	return true;
 }
 
 bool encoder::operator<<(const frame &f) { return send(f.f); }
@@ -758,6 +1234,26 @@ bool encoder::operator>>(packet &p)
 	return receive(p.p);
 }
 
+/*
+ * an encoder attached to no output stream, opened as output::add_stream()
+ * does
+ */
+encoder encoder::open(const std::string &codec, const std::string &options,
+		      bool global_header)
+{
+	AVCodecParameters *par = avcodec_parameters_alloc();
+	encoder enc;
+
+	if (!par)
+		return enc;
+
+	enc.ctx = ffmpeg_encoder_context(codec, options, par, global_header,
+					 nullptr);
+
+	avcodec_parameters_free(&par);
+	return enc;
+}
+
 frame encoder::get_empty_frame()
 {
 	frame f;
@@ -774,16 +1270,332 @@ frame encoder::get_empty_frame()
 	return f;
 }
 
+/*
+ * libx264 and nvenc compare their rate control settings with the context
+ * on every frame and reconfigure themselves when they differ. VBV can only
+ * be changed when enabled at opening, as the bitrate in ABR mode and crf in
+ * CRF mode. Keyframes are forced on frames, g can only be shortened.
+ */
+bool encoder::runtime_option(const char *key, const char *value) const
+{
+	std::string name = ctx->codec->name;
+	bool x264 = name == "libx264" || name == "libx264rgb";
+	bool nvenc = name.ends_with("_nvenc");
+	std::string k = key;
+
+	if (k == "keyframe")
+		return ctx->codec_type == AVMEDIA_TYPE_VIDEO;
+
+	if (k == "g") {
+		int g = atoi(value);
+
+		return ctx->codec_type == AVMEDIA_TYPE_VIDEO && g > 0 &&
+		       (ctx->gop_size <= 0 || g <= ctx->gop_size);
+	}
+
+	if (k == "b")
+		return (x264 || nvenc) && ctx->bit_rate > 0;
+
+	if (k == "maxrate" || k == "bufsize")
+		return (x264 || nvenc) && ctx->rc_buffer_size > 0;
+
+	if (k == "crf")
+		return x264 && ctx->bit_rate == 0;
+
+	return false;
+}
+
+bool encoder::reconfigure(const std::string &options)
+{
+	AVDictionary *d = nullptr;
+	const AVDictionaryEntry *e = nullptr;
+	bool ret = true;
+
+	if (av_dict_parse_string(&d, options.c_str(), "=", ":", 0) < 0) {
+		fmt::print(stderr, "Invalid options '{}'\n", options);
+		av_dict_free(&d);
+		return false;
+	}
+
+	while ((e = av_dict_get(d, "", e, AV_DICT_IGNORE_SUFFIX))) {
+		if (!runtime_option(e->key, e->value)) {
+			fmt::print(stderr, "Encoder '{}' cannot change '{}={}' "
+					   "while encoding\n",
+				   ctx->codec->name, e->key, e->value);
+			av_dict_free(&d);
+			return false;
+		}
+	}
+
+	while (ret && (e = av_dict_get(d, "", e, AV_DICT_IGNORE_SUFFIX))) {
+		std::string k = e->key;
+
+		if (k == "keyframe")
+			force_key = atoi(e->value) != 0;
+		else if (k == "g") {
+			gop = atoi(e->value);
+			since_key = 0;
+		} else if (av_opt_set(ctx, e->key, e->value,
+				      AV_OPT_SEARCH_CHILDREN) < 0) {
+			fmt::print(stderr, "Cannot set '{}={}'\n", e->key,
+				   e->value);
+			ret = false;
+		}
+	}
+
+	av_dict_free(&d);
+	return ret;
+}
+
+bsf::~bsf() { av_bsf_free(&ctx); }
+
+bsf::bsf(bsf &&o)
+{
+	ctx = o.ctx;
+	o.ctx = nullptr;
+}
+
+bsf &bsf::operator=(bsf &&o)
+{
+	if (ctx != o.ctx) {
+		av_bsf_free(&ctx);
+		ctx = o.ctx;
+		o.ctx = nullptr;
+	}
+	return *this;
+}
+
+bool bsf::open(const std::string &name, const AVCodecParameters *par,
+	       AVRational time_base)
+{
+	const AVBitStreamFilter *filter;
+
+	av_bsf_free(&ctx);
+
+	filter = av_bsf_get_by_name(name.c_str());
+	if (!filter) {
+		fmt::print(stderr, "Cannot find bitstream filter '{}'\n", name);
+		return false;
+	}
+
+	if (av_bsf_alloc(filter, &ctx) < 0)
+		return false;
+
+	if (avcodec_parameters_copy(ctx->par_in, par) < 0)
+		goto free_context;
+
+	ctx->time_base_in = time_base;
+
+	if (av_bsf_init(ctx) < 0) {
+		fmt::print(stderr, "Cannot init bitstream filter '{}'\n", name);
+		goto free_context;
+	}
+
+	return true;
+free_context:
+	av_bsf_free(&ctx);
+	return false;
+}
+
+bool bsf::send(AVPacket *packet)
+{
+	int ret;
+
+	ret = av_bsf_send_packet(ctx, packet);
+
+	return !(ret < 0);
+}
+
+bool bsf::flush() { return send(nullptr); }
+
+bool bsf::receive(AVPacket *packet)
+{
+	int ret;
+
+	ret = av_bsf_receive_packet(ctx, packet);
+
+	return !(ret < 0);
+}
+
+bool bsf::operator!() { return (ctx == nullptr); }
+
+const AVCodecParameters *bsf::parameters() const { return ctx->par_out; }
+
+AVRational bsf::time_base() const { return ctx->time_base_out; }
+
+bsf_chain::~bsf_chain() { av_packet_free(&scratch); }
+
+bsf_chain::bsf_chain(bsf_chain &&o)
+{
+	filters = std::move(o.filters);
+	flushed = std::move(o.flushed);
+	names = std::move(o.names);
+	scratch = o.scratch;
+
+	o.filters.clear();
+	o.scratch = nullptr;
+}
+
+bsf_chain &bsf_chain::operator=(bsf_chain &&o)
+{
+	if (this != &o) {
+		av_packet_free(&scratch);
+
+		filters = std::move(o.filters);
+		flushed = std::move(o.flushed);
+		names = std::move(o.names);
+		scratch = o.scratch;
+
+		o.filters.clear();
+		o.scratch = nullptr;
+	}
+	return *this;
+}
+
+bool bsf_chain::open(const std::string &names, const AVCodecParameters *par,
+		     AVRational time_base)
+{
+	size_t start = 0;
+
+	filters.clear();
+
+	while (start <= names.size()) {
+		size_t end = names.find(',', start);
+		bsf filter;
+
+		if (end == std::string::npos)
+			end = names.size();
+
+		if (!filter.open(names.substr(start, end - start), par,
+				 time_base)) {
+			filters.clear();
+			return false;
+		}
+
+		par = filter.parameters();
+		time_base = filter.time_base();
+		filters.push_back(std::move(filter));
+
+		start = end + 1;
+	}
+
+	flushed.assign(filters.size(), false);
+	this->names = names;
+
+	if (!scratch)
+		scratch = av_packet_alloc();
+
+	return true;
+}
+
+bool bsf_chain::open(const bsf_chain &o)
+{
+	if (o.empty()) {
+		filters.clear();
+		return true;
+	}
+
+	return open(o, o.filters.front().ctx->time_base_in);
+}
+
+// the same filters for packets in another time base
+bool bsf_chain::open(const bsf_chain &o, AVRational time_base)
+{
+	if (o.empty()) {
+		filters.clear();
+		return true;
+	}
+
+	return open(o.names, o.filters.front().ctx->par_in, time_base);
+}
+
+bool bsf_chain::send(AVPacket *packet)
+{
+	if (filters.empty())
+		return false;
+
+	return filters.front().send(packet);
+}
+
+bool bsf_chain::flush()
+{
+	if (filters.empty())
+		return false;
+
+	flushed[0] = true;
+	return filters.front().flush();
+}
+
+bool bsf_chain::receive(AVPacket *packet)
+{
+	int last = filters.size() - 1;
+	int i = last;
+
+	// pull the packets through the chain from its end
+	while (i >= 0) {
+		int ret = av_bsf_receive_packet(filters[i].ctx, packet);
+
+		if (ret == 0) {
+			if (i == last)
+				return true;
+
+			if (!filters[i + 1].send(packet))
+				return false;
+			i++;
+		} else if (ret == AVERROR(EAGAIN))
+			i--;
+		else if (ret == AVERROR_EOF && i < last && !flushed[i + 1]) {
+			flushed[i + 1] = true;
+			filters[i + 1].flush();
+			i++;
+		} else
+			return false;
+	}
+	return false;
+}
+
+bool bsf_chain::operator<<(const packet &p)
+{
+	if (av_packet_ref(scratch, p.p) < 0)
+		return false;
+
+	// the filter only takes the reference when it accepts the packet
+	if (!send(scratch)) {
+		av_packet_unref(scratch);
+		return false;
+	}
+	return true;
+}
+
+bool bsf_chain::operator>>(packet &p)
+{
+	av_packet_unref(p.p);
+	return receive(p.p);
+}
+
+const AVCodecParameters *bsf_chain::parameters() const
+{
+	return filters.back().parameters();
+}
+
 output::output(output &&o)
 {
 	ctx = o.ctx;
 	write_header = o.write_header;
 	write_trailer = o.write_trailer;
 	time_bases = o.time_bases;
+	options = o.options;
+	filters = std::move(o.filters);
+	prescaled = std::move(o.prescaled);
+	filtered = o.filtered;
 
 	o.ctx = nullptr;
 	o.write_header = o.write_trailer = false;
 	o.time_bases.clear();
+	o.options.clear();
+	o.filters.clear();
+	o.prescaled.clear();
+	o.filtered = nullptr;
 }
 
 output &output::operator=(output &&o)
@@ -795,22 +1607,35 @@ output &output::operator=(output &&o)
 		write_header = o.write_header;
 		write_trailer = o.write_trailer;
 		time_bases = o.time_bases;
+		options = o.options;
+		filters = std::move(o.filters);
+		prescaled = std::move(o.prescaled);
+		filtered = o.filtered;
 
 		o.ctx = nullptr;
 		o.write_header = o.write_trailer = false;
 		o.time_bases.clear();
+		o.options.clear();
+		o.filters.clear();
+		o.prescaled.clear();
+		o.filtered = nullptr;
 	}
 	return *this;
 }
 
-bool output::open(const std::string &uri)
+bool output::open(const std::string &uri) { return open_format(uri, ""); }
+
+bool output::open_format(const std::string &uri, const std::string &format,
+			 const std::string &options)
 {
 	close();
 
-	ctx = ffmpeg_output_format_context(uri);
+	ctx = ffmpeg_output_format_context(uri, format);
 	if (!ctx)
 		return false;
 
+	this->options = options;
+
 	if (!(ctx->oformat->flags & AVFMT_NOFILE))
 		if (avio_open(&ctx->pb, uri.c_str(), AVIO_FLAG_WRITE) < 0)
 			return false;
@@ -850,9 +1675,58 @@ encoder output::add_stream(const hw_frames &frames, const std::string &codec,
 	return enc;
 }
 
+/*
+ * add a stream for an encoder opened before, with the same global header
+ * setting as this output
+ */
+int output::attach(const AVCodecContext *codec_ctx)
+{
+	AVStream *stream;
+
+	stream = avformat_new_stream(ctx, nullptr);
+	if (!stream) {
+		fmt::print(stderr, "avformat_new_stream fails\n");
+		return -1;
+	}
+
+	if (avcodec_parameters_from_context(stream->codecpar, codec_ctx) < 0) {
+		fmt::print(stderr, "can't copy the stream parameters\n");
+		return -1;
+	}
+	stream->id = ctx->nb_streams - 1;
+
+	time_bases.resize(ctx->nb_streams);
+	time_bases[stream->id] = codec_ctx->time_base;
+
+	return stream->id;
+}
+
 int output::add_stream(const input &in, int index)
 {
+	const AVCodecParameters *par;
+
+	assert((unsigned int)index < in.ctx->nb_streams);
+	par = in.ctx->streams[index]->codecpar;
+
+	return add_stream(in, index, ffmpeg_required_bsfs(ctx->oformat, par));
+}
+
+int output::add_stream(const input &in, int index, const std::string &bsfs)
+{
+	const AVCodecParameters *par;
 	AVStream *stream;
+	bsf_chain chain;
+
+	assert((unsigned int)index < in.ctx->nb_streams);
+
+	par = in.ctx->streams[index]->codecpar;
+
+	if (!bsfs.empty()) {
+		if (!chain.open(bsfs, par, in.ctx->streams[index]->time_base))
+			return -1;
+
+		par = chain.parameters();
+	}
 
 	stream = avformat_new_stream(ctx, nullptr);
 	if (!stream) {
@@ -860,8 +1734,7 @@ int output::add_stream(const input &in, int index)
 		return -1;
 	}
 
-	if (avcodec_parameters_copy(stream->codecpar,
-				    in.ctx->streams[index]->codecpar) < 0) {
+	if (avcodec_parameters_copy(stream->codecpar, par) < 0) {
 		fmt::print(stderr, "Failed to copy codec parameters\n");
 		return -1;
 	}
@@ -870,24 +1743,114 @@ int output::add_stream(const input &in, int index)
 
 	time_bases.resize(ctx->nb_streams);
 	time_bases[stream->id] = in.ctx->streams[index]->time_base;
+
+	filters.resize(ctx->nb_streams);
+	filters[stream->id] = std::move(chain);
+	prescaled.resize(ctx->nb_streams);
 	return stream->id;
 }
 
-int output::write(AVPacket *packet, bool rescale)
+int output::add_stream(const output &o, int index)
+{
+	AVStream *stream;
+
+	assert((unsigned int)index < o.ctx->nb_streams);
+
+	stream = avformat_new_stream(ctx, nullptr);
+	if (!stream) {
+		fmt::print(stderr, "avformat_new_stream fails\n");
+		return -1;
+	}
+
+	if (avcodec_parameters_copy(stream->codecpar,
+				    o.ctx->streams[index]->codecpar) < 0) {
+		fmt::print(stderr, "Failed to copy codec parameters\n");
+		return -1;
+	}
+	stream->id = ctx->nb_streams - 1;
+
+	time_bases.resize(ctx->nb_streams);
+	time_bases[stream->id] = o.time_bases[index];
+
+	filters.resize(ctx->nb_streams);
+	prescaled.resize(ctx->nb_streams);
+	if ((unsigned int)index < o.filters.size() &&
+	    !filters[stream->id].open(o.filters[index],
+				      time_bases[stream->id]))
+		return -1;
+
+	return stream->id;
+}
+
+AVRational output::time_base(int index) const
+{
+	assert((unsigned int)index < time_bases.size());
+	return time_bases[index];
+}
+
+int output::prepare()
 {
 	if (write_header) {
 		int ret;
 
 		// av_dump_format(ctx, 0, "output", 1);
 
-		ret = avformat_write_header(ctx, nullptr);
+		ret = avformat_write_header(ctx, dictionary(options).ptr());
 		if (ret < 0)
 			return ret;
 
 		write_header = false;
 		write_trailer = true;
 	}
+	return 0;
+}
 
+int output::write(AVPacket *packet, bool rescale, bool interleave)
+{
+	int index = packet->stream_index;
+	int ret = prepare();
+
+	if (ret < 0)
+		return ret;
+
+	if ((unsigned int)index >= filters.size() || filters[index].empty())
+		return write_filtered(packet, rescale, interleave);
+
+	if (!filtered)
+		filtered = av_packet_alloc();
+
+	/*
+	 * the filters are opened in the time base of the packets given to
+	 * write(), reopened in the one of the output stream for packets
+	 * already rescaled to it (remux)
+	 */
+	if (prescaled[index] == rescale) {
+		AVRational tb = rescale ? time_bases[index]
+					: ctx->streams[index]->time_base;
+		bsf_chain chain;
+
+		if (!chain.open(filters[index], tb))
+			return AVERROR(EINVAL);
+
+		filters[index] = std::move(chain);
+		prescaled[index] = !rescale;
+	}
+
+	if (!filters[index].send(packet))
+		return AVERROR(EINVAL);
+
+	while (filters[index].receive(filtered)) {
+		ret = write_filtered(filtered, rescale, interleave);
+		av_packet_unref(filtered);
+
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+int output::write_filtered(AVPacket *packet, bool rescale, bool interleave)
+{
 	if (rescale) {
 		int index = packet->stream_index;
 
@@ -898,6 +1861,10 @@ int output::write(AVPacket *packet, bool rescale)
 	}
 
 	packet->pos = -1;
+
+	if (!interleave)
+		return av_write_frame(ctx, packet);
+
 	return av_interleaved_write_frame(ctx, packet);
 }
 
@@ -934,14 +1901,126 @@ void output::close()
 	if (!ctx)
 		return;
 
-	if (write_trailer)
+	if (write_trailer) {
+		/*
+		 * drain the packets held by the bitstream filters: nothing
+		 * is held when no packet went through them, filtered is
+		 * only allocated with the first one
+		 */
+		for (size_t i = 0; i < filters.size(); i++) {
+			bsf_chain &chain = filters[i];
+
+			if (!filtered || chain.empty() || !chain.flush())
+				continue;
+
+			while (chain.receive(filtered)) {
+				write_filtered(filtered, !prescaled[i], true);
+				av_packet_unref(filtered);
+			}
+		}
+
 		av_write_trailer(ctx);
+	}
 
 	if (!(ctx->oformat->flags & AVFMT_NOFILE))
 		avio_closep(&ctx->pb);
 
 	avformat_free_context(ctx);
 	ctx = nullptr;
+
+	filters.clear();
+	prescaled.clear();
+	av_packet_free(&filtered);
+}
+
+bool remux(input &in, output &out, const std::vector<int> &stream_map,
+	   const std::function<bool(const remux_progress &)> &progress)
+{
+	struct rescaler {
+		int index;
+		int64_t mul;
+		AVRational from, to;
+	};
+	std::vector<rescaler> rescalers(in.ctx->nb_streams);
+	remux_progress stats = {0, 0, 0};
+	AVPacket *packet;
+	int mapped = 0;
+	bool ret = true;
+
+	if (out.prepare() < 0)
+		return false;
+
+	// the output time bases are only known once the header is written
+	for (unsigned int i = 0; i < in.ctx->nb_streams; i++) {
+		rescaler &r = rescalers[i];
+
+		r.index = i;
+		if (!stream_map.empty())
+			r.index = i < stream_map.size() ? stream_map[i] : -1;
+
+		if (r.index < 0)
+			continue;
+		if ((unsigned int)r.index >= out.ctx->nb_streams)
+			return false;
+
+		r.from = in.ctx->streams[i]->time_base;
+		r.to = out.ctx->streams[r.index]->time_base;
+
+		AVRational ratio = av_div_q(r.from, r.to);
+
+		r.mul = ratio.den == 1 ? ratio.num : 0;
+		mapped++;
+	}
+
+	packet = av_packet_alloc();
+
+	while (av_read_frame(in.ctx, packet) >= 0) {
+		// streams found after the header (mpegts) are not copied
+		if ((size_t)packet->stream_index >= rescalers.size()) {
+			av_packet_unref(packet);
+			continue;
+		}
+
+		rescaler &r = rescalers[packet->stream_index];
+
+		if (r.index < 0) {
+			av_packet_unref(packet);
+			continue;
+		}
+
+		stats.packets++;
+		stats.bytes += packet->size;
+		if (packet->dts != AV_NOPTS_VALUE)
+			stats.seconds = packet->dts * av_q2d(r.from);
+
+		if (r.mul == 0)
+			av_packet_rescale_ts(packet, r.from, r.to);
+		else if (r.mul != 1) {
+			if (packet->pts != AV_NOPTS_VALUE)
+				packet->pts *= r.mul;
+			if (packet->dts != AV_NOPTS_VALUE)
+				packet->dts *= r.mul;
+			packet->duration *= r.mul;
+		}
+
+		packet->stream_index = r.index;
+
+		if (out.write(packet, false, mapped > 1) < 0) {
+			ret = false;
+			break;
+		}
+		av_packet_unref(packet);
+
+		if (progress && stats.packets % 256 == 0 && !progress(stats))
+			break;
+	}
+
+	av_packet_free(&packet);
+
+	if (progress)
+		progress(stats);
+
+	return ret;
 }
 
 } // namespace av
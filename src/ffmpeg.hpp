@@ -1,20 +1,51 @@
 #pragma once
 #include <fmt/ostream.h>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavcodec/bsf.h>
 #include <libavformat/avformat.h>
 }
 
 struct SwsContext;
+struct SwrContext;
 
 namespace av
 {
 
 std::string to_string(const AVRational &r);
 
+/*
+ * Whether streams with these parameters can share a decoder, or be stream
+ * copied one after the other into the same output stream.
+ */
+bool compatible(const AVCodecParameters *a, const AVCodecParameters *b);
+
+class input;
+class output;
+class memory_budget;
+
+struct remux_progress {
+	uint64_t packets;
+	uint64_t bytes;
+	double seconds;
+};
+
+/*
+ * Stream copy of an input to an output whose streams were added with
+ * output::add_stream(input, index). stream_map gives the output stream of
+ * each input stream, -1 to drop it, an empty map copies stream i to stream
+ * i. Timestamps are rescaled with factors computed once per stream and
+ * libavformat interleaving is skipped when a single stream is copied.
+ * progress is called every 256 packets, returning false stops the copy.
+ */
+bool remux(input &in, output &out, const std::vector<int> &stream_map = {},
+	   const std::function<bool(const remux_progress &)> &progress = {});
+
 class packet
 {
 public:
@@ -30,12 +61,25 @@ public:
 	int stream_index() const;
 	void stream_index(int index);
 
+	int64_t pts() const;
+	int64_t dts() const;
+	int size() const;
+	const uint8_t *data() const;
+	bool is_keyframe() const;
+
 	void add_delta_pts(int64_t delta);
 
 	friend class input;
 	friend class output;
 	friend class encoder;
 	friend class decoder;
+	friend class interleaver;
+	friend class bsf;
+	friend class bsf_chain;
+	friend class packet_analyzer;
+	friend uint64_t hash(const packet &p);
+	friend class smart_cutter;
+	friend class concatenator;
 
 private:
 	AVPacket *p;
@@ -74,6 +118,30 @@ struct frame {
 		int w, h, src_w, src_h;
 	};
 
+	/*
+	 * Audio counterpart of the scaler: converts sample format, rate and
+	 * channel layout, rebuilt when the input frames change. Rate
+	 * conversions keep a few samples buffered, the frame sizes vary.
+	 */
+	class resampler
+	{
+	public:
+		resampler(AVSampleFormat format, int sample_rate,
+			  const AVChannelLayout &layout);
+		~resampler();
+
+		frame resample(const frame &f);
+
+	private:
+		resampler(const resampler &) = delete;
+		resampler &operator=(const resampler &) = delete;
+
+		SwrContext *ctx;
+		AVSampleFormat fmt, src_fmt;
+		int rate, src_rate;
+		AVChannelLayout layout, src_layout;
+	};
+
 	AVFrame *f;
 };
 
@@ -136,6 +204,8 @@ public:
 
 protected:
 	AVCodecContext *ctx;
+	// codec_pool entry of a pooled context, freed along with it
+	std::shared_ptr<void> pool_key;
 
 private:
 	codec(const codec &) = delete;
@@ -147,6 +217,8 @@ private:
 class decoder : public codec
 {
 public:
+	decoder() : budget(nullptr) {}
+
 	bool send(const AVPacket *packet);
 	bool flush();
 	bool receive(AVFrame *frame);
@@ -154,27 +226,97 @@ public:
 	bool operator<<(const packet &p);
 	bool operator>>(frame &f);
 
+	void reset();
+	void discard(AVDiscard level);
+
 	hw_frames get_hw_frames();
 
+	void set_budget(memory_budget *budget);
+
 	friend class input;
+	friend class codec_pool;
+	friend std::string negotiate(const decoder &dec,
+				     const std::string &codec);
+
+private:
+	memory_budget *budget;
+};
+
+/*
+ * How much of an input is analyzed by avformat_find_stream_info: full uses
+ * the ffmpeg defaults, fast and minimal lower probesize, analyzeduration
+ * and fpsprobesize for quicker startup of live sources.
+ */
+enum class probe { full, fast, minimal };
+
+/*
+ * Low-latency profile: options favouring end-to-end delay over compression,
+ * to use with input::open(), input::get() and output::add_stream(). The
+ * given options are applied after the profile ones and override them.
+ */
+namespace low_latency
+{
+std::string input_options(const std::string &uri,
+			  const std::string &options = "");
+std::string decoder_options(const std::string &options = "");
+std::string encoder_options(const std::string &codec,
+			    const std::string &options = "");
+} // namespace low_latency
+
+/*
+ * Codec parameters of the streams of an opened input, to reopen the same
+ * source later without probing it.
+ */
+class stream_info
+{
+public:
+	stream_info() {}
+	~stream_info();
+
+	stream_info(const stream_info &o);
+	stream_info &operator=(const stream_info &o);
+
+	stream_info(stream_info &&o);
+	stream_info &operator=(stream_info &&o);
+
+	bool empty() const { return params.empty(); }
+
+	friend class input;
+
+private:
+	bool apply(AVFormatContext *fmt_ctx) const;
+	void clear();
+
+	std::vector<AVCodecParameters *> params;
+	std::vector<AVRational> frame_rates;
 };
 
 class input
 {
 public:
-	input() : ctx(nullptr) {}
+	input() : ctx(nullptr), budget(nullptr) {}
 	~input() { close(); }
 
 	input(input &&o);
 	input &operator=(input &&o);
 
 	bool open(const std::string &uri, const std::string &options = "");
+	bool open(const std::string &uri, probe mode,
+		  const std::string &options = "");
+	bool open(const std::string &uri, const stream_info &info,
+		  const std::string &options = "");
 	bool open_format(const std::string &uri, const std::string &format,
-			 const std::string &options = "");
+			 const std::string &options = "",
+			 probe mode = probe::full);
+
+	stream_info get_stream_info() const;
 
 	int read(AVPacket *packet);
 	bool operator>>(packet &p);
 
+	bool seek(int index, int64_t timestamp);
+
+	int nb_streams() const;
 	int get_video_index(int id = -1) const;
 	int get_audio_index(int id = -1) const;
 
@@ -189,12 +331,22 @@ public:
 	int64_t start_time_realtime() const;
 	AVRational frame_rate(int index) const;
 	AVRational time_base(int index) const;
+	int64_t start_time(int index) const;
+	int64_t duration(int index) const;
 
 	std::string metadata() const;
 	std::string program_metadata(int index) const;
 	std::string stream_metadata(int index) const;
 
+	void set_budget(memory_budget *budget);
+
 	friend class output;
+	friend class codec_pool;
+	friend class packet_analyzer;
+	friend class smart_cutter;
+	friend class concatenator;
+	friend bool remux(input &, output &, const std::vector<int> &,
+			  const std::function<bool(const remux_progress &)> &);
 
 private:
 	input(const input &) = delete;
@@ -203,12 +355,18 @@ private:
 	void close();
 
 	AVFormatContext *ctx;
+	memory_budget *budget;
+	std::vector<bool> shedding;
 };
 
 class encoder : public codec
 {
 public:
-	encoder() : stream_index(-1) {}
+	encoder()
+	    : stream_index(-1), gop(0), since_key(0), delayed(0),
+	      force_key(false)
+	{
+	}
 
 	bool send(const AVFrame *frame);
 	bool flush();
@@ -219,30 +377,143 @@ public:
 
 	frame get_empty_frame();
 
+	/*
+	 * Changes settings of the opened encoder between two frames, from the
+	 * thread feeding it: b, maxrate and bufsize (libx264 and nvenc, opened
+	 * with a bitrate and a VBV buffer), crf (libx264 opened without a
+	 * bitrate), g to shorten the keyframe interval and keyframe=1 for a
+	 * keyframe at the next frame. Nothing is changed when one of the
+	 * options needs the encoder to be reopened.
+	 */
+	bool reconfigure(const std::string &options);
+
 	friend class output;
+	friend class fanout;
+	friend class segmenter;
+	friend class codec_pool;
+	friend class parallel_encoder;
+	friend class thumbnailer;
+	friend class converter;
+	friend class smart_cutter;
+	friend class concatenator;
 
 private:
+	static encoder open(const std::string &codec,
+			    const std::string &options, bool global_header);
+
+	bool runtime_option(const char *key, const char *value) const;
+
 	int stream_index;
+	// frames sent since the last keyframe, frames not out as packets yet
+	int gop, since_key, delayed;
+	bool force_key;
+};
+
+class bsf
+{
+public:
+	bsf() : ctx(nullptr) {}
+	~bsf();
+
+	bsf(bsf &&o);
+	bsf &operator=(bsf &&o);
+
+	bool open(const std::string &name, const AVCodecParameters *par,
+		  AVRational time_base);
+
+	bool send(AVPacket *packet);
+	bool flush();
+	bool receive(AVPacket *packet);
+
+	bool operator!();
+
+	const AVCodecParameters *parameters() const;
+	AVRational time_base() const;
+
+	friend class bsf_chain;
+
+private:
+	bsf(const bsf &) = delete;
+	bsf &operator=(const bsf &) = delete;
+
+	AVBSFContext *ctx;
+};
+
+/*
+ * Bitstream filters applied one after the other. Packets are moved by
+ * reference through the chain, filters like aac_adtstoasc or dump_extra
+ * then never copy the payload.
+ */
+class bsf_chain
+{
+public:
+	bsf_chain() : scratch(nullptr) {}
+	~bsf_chain();
+
+	bsf_chain(bsf_chain &&o);
+	bsf_chain &operator=(bsf_chain &&o);
+
+	bool open(const std::string &names, const AVCodecParameters *par,
+		  AVRational time_base);
+	bool open(const bsf_chain &o);
+	bool open(const bsf_chain &o, AVRational time_base);
+
+	bool send(AVPacket *packet);
+	bool flush();
+	bool receive(AVPacket *packet);
+
+	bool operator<<(const packet &p);
+	bool operator>>(packet &p);
+
+	bool empty() const { return filters.empty(); }
+	const AVCodecParameters *parameters() const;
+
+private:
+	bsf_chain(const bsf_chain &) = delete;
+	bsf_chain &operator=(const bsf_chain &) = delete;
+
+	std::vector<bsf> filters;
+	std::vector<bool> flushed;
+	std::string names;
+	AVPacket *scratch;
 };
 
 class output
 {
 public:
-	output() : ctx(nullptr), write_header(false), write_trailer(false) {}
+	output()
+	    : ctx(nullptr), write_header(false), write_trailer(false),
+	      filtered(nullptr)
+	{
+	}
 	~output() { close(); }
 
 	output(output &&o);
 	output &operator=(output &&o);
 
 	bool open(const std::string &uri);
+	bool open_format(const std::string &uri, const std::string &format,
+			 const std::string &options = "");
 
 	encoder add_stream(const std::string &codec,
 			   const std::string &options = "");
 	encoder add_stream(const hw_frames &frames, const std::string &codec,
 			   const std::string &options = "");
+	/*
+	 * Stream copy of an input stream. Without bsfs, the bitstream
+	 * filters the muxer needs for a source from another container are
+	 * inserted (h264/hevc_mp4toannexb for mpegts and raw annex-b,
+	 * aac_adtstoasc for mp4-like ones): pass an empty bsfs to copy the
+	 * packets untouched.
+	 */
 	int add_stream(const input &in, int index);
+	int add_stream(const input &in, int index, const std::string &bsfs);
+	int add_stream(const output &o, int index);
+
+	AVRational time_base(int index) const;
 
-	int write(AVPacket *packet, bool rescale = true);
+	int write(AVPacket *packet, bool rescale = true,
+		  bool interleave = true);
 	bool operator<<(const packet &p);
 	bool write_norescale(const packet &p);
 
@@ -250,15 +521,31 @@ public:
 	void add_program_metadata(const std::string &data, int index);
 	void add_stream_metadata(const std::string &data, int index);
 
+	friend class segmenter;
+	friend class interleaver;
+	friend class codec_pool;
+	friend class smart_cutter;
+	friend class concatenator;
+	friend bool remux(input &, output &, const std::vector<int> &,
+			  const std::function<bool(const remux_progress &)> &);
+
 private:
 	output(const output &) = delete;
 	output &operator=(const output &) = delete;
 
+	int prepare();
+	int attach(const AVCodecContext *codec_ctx);
+	int write_filtered(AVPacket *packet, bool rescale, bool interleave);
 	void close();
 
 	AVFormatContext *ctx;
 	bool write_header, write_trailer;
 	std::vector<AVRational> time_bases;
+	std::string options;
+	std::vector<bsf_chain> filters;
+	// per stream, packets sent to the filters are in the output time base
+	std::vector<bool> prescaled;
+	AVPacket *filtered;
 };
 
 } // namespace av
@@ -0,0 +1,164 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+namespace av
+{
+
+/*
+ * Layout of a pixel format known at compile time: element type, number of
+ * planes, interleaved components per plane and which planes are chroma
+ * subsampled by log2_chroma_w/h.
+ */
+template <AVPixelFormat F> struct pixel_traits;
+
+template <> struct pixel_traits<AV_PIX_FMT_GRAY8> {
+	using type = uint8_t;
+	static constexpr int planes = 1;
+	static constexpr std::array<int, 1> components = {1};
+	static constexpr std::array<bool, 1> chroma = {false};
+	static constexpr int log2_chroma_w = 0, log2_chroma_h = 0;
+};
+
+template <> struct pixel_traits<AV_PIX_FMT_YUV420P> {
+	using type = uint8_t;
+	static constexpr int planes = 3;
+	static constexpr std::array<int, 3> components = {1, 1, 1};
+	static constexpr std::array<bool, 3> chroma = {false, true, true};
+	static constexpr int log2_chroma_w = 1, log2_chroma_h = 1;
+};
+
+template <> struct pixel_traits<AV_PIX_FMT_YUV422P> {
+	using type = uint8_t;
+	static constexpr int planes = 3;
+	static constexpr std::array<int, 3> components = {1, 1, 1};
+	static constexpr std::array<bool, 3> chroma = {false, true, true};
+	static constexpr int log2_chroma_w = 1, log2_chroma_h = 0;
+};
+
+template <> struct pixel_traits<AV_PIX_FMT_YUV444P> {
+	using type = uint8_t;
+	static constexpr int planes = 3;
+	static constexpr std::array<int, 3> components = {1, 1, 1};
+	static constexpr std::array<bool, 3> chroma = {false, true, true};
+	static constexpr int log2_chroma_w = 0, log2_chroma_h = 0;
+};
+
+template <> struct pixel_traits<AV_PIX_FMT_YUV420P10LE> {
+	using type = uint16_t;
+	static constexpr int planes = 3;
+	static constexpr std::array<int, 3> components = {1, 1, 1};
+	static constexpr std::array<bool, 3> chroma = {false, true, true};
+	static constexpr int log2_chroma_w = 1, log2_chroma_h = 1;
+};
+
+template <> struct pixel_traits<AV_PIX_FMT_NV12> {
+	using type = uint8_t;
+	static constexpr int planes = 2;
+	static constexpr std::array<int, 2> components = {1, 2};
+	static constexpr std::array<bool, 2> chroma = {false, true};
+	static constexpr int log2_chroma_w = 1, log2_chroma_h = 1;
+};
+
+template <> struct pixel_traits<AV_PIX_FMT_RGB24> {
+	using type = uint8_t;
+	static constexpr int planes = 1;
+	static constexpr std::array<int, 1> components = {3};
+	static constexpr std::array<bool, 1> chroma = {false};
+	static constexpr int log2_chroma_w = 0, log2_chroma_h = 0;
+};
+
+template <> struct pixel_traits<AV_PIX_FMT_RGBA> {
+	using type = uint8_t;
+	static constexpr int planes = 1;
+	static constexpr std::array<int, 1> components = {4};
+	static constexpr std::array<bool, 1> chroma = {false};
+	static constexpr int log2_chroma_w = 0, log2_chroma_h = 0;
+};
+
+/*
+ * Typed access to the pixels of a software frame of format F. Rows are
+ * spans of plane width times components elements, so kernels written as
+ * plain loops over a row have a known stride and vectorize. The view is
+ * checked on construction: a frame of another format, a hardware frame
+ * or, for a writable view, a frame shared with other references gives an
+ * empty view. Use const_frame_view to read shared frames.
+ */
+template <AVPixelFormat F, typename E = typename pixel_traits<F>::type>
+class frame_view
+{
+public:
+	using traits = pixel_traits<F>;
+	using element = E;
+
+	static_assert(
+	    std::is_same_v<std::remove_const_t<E>, typename traits::type>);
+
+	static constexpr int nb_planes = traits::planes;
+	static constexpr bool writable = !std::is_const_v<E>;
+
+	explicit frame_view(AVFrame *frame) : f(nullptr)
+	{
+		if (frame->format != F || frame->hw_frames_ctx ||
+		    !frame->data[0])
+			return;
+
+		if (writable && !av_frame_is_writable(frame))
+			return;
+
+		f = frame;
+	}
+
+	// a const frame only gives a read-only view
+	explicit frame_view(frame &src) : frame_view(src.f) {}
+	explicit frame_view(const frame &src)
+		requires(!writable)
+	    : frame_view(src.f)
+	{
+	}
+
+	bool operator!() const { return f == nullptr; }
+
+	static constexpr int width(int plane, int width)
+	{
+		return traits::chroma[plane]
+			   ? -((-width) >> traits::log2_chroma_w)
+			   : width;
+	}
+
+	static constexpr int height(int plane, int height)
+	{
+		return traits::chroma[plane]
+			   ? -((-height) >> traits::log2_chroma_h)
+			   : height;
+	}
+
+	int width(int plane) const { return width(plane, f->width); }
+	int height(int plane) const { return height(plane, f->height); }
+
+	template <int P> std::span<E> row(int y) const
+	{
+		static_assert(P >= 0 && P < nb_planes);
+
+		return {reinterpret_cast<E *>(f->data[P] + y * f->linesize[P]),
+			(size_t)(width(P) * traits::components[P])};
+	}
+
+	std::span<E> row(int plane, int y) const
+	{
+		return {reinterpret_cast<E *>(f->data[plane] +
+					      y * f->linesize[plane]),
+			(size_t)(width(plane) * traits::components[plane])};
+	}
+
+private:
+	AVFrame *f;
+};
+
+template <AVPixelFormat F>
+using const_frame_view = frame_view<F, const typename pixel_traits<F>::type>;
+
+} // namespace av
@@ -0,0 +1,180 @@
+#include "hash.hpp"
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace av
+{
+
+static const char *framehash_header = "#framehash xxh3\n"
+				      "#stream, pts, size, hash\n";
+
+static uint64_t hash_plane(const uint8_t *data, int linesize, size_t width,
+			   int height)
+{
+	XXH3_state_t state;
+
+	// no padding, or a single row: one call over the whole plane
+	if ((size_t)linesize == width || height == 1)
+		return XXH3_64bits(data, width * height);
+
+	XXH3_64bits_reset(&state);
+	for (int y = 0; y < height; y++)
+		XXH3_64bits_update(&state, data + (ptrdiff_t)y * linesize,
+				   width);
+
+	return XXH3_64bits_digest(&state);
+}
+
+frame_hash hash(const frame &f)
+{
+	const AVPixFmtDescriptor *desc;
+	AVPixelFormat format = (AVPixelFormat)f.f->format;
+	frame_hash h = {};
+
+	desc = av_pix_fmt_desc_get(format);
+	if (!desc ||
+	    (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)) ||
+	    !f.f->data[0])
+		return h;
+
+	h.nb_planes = av_pix_fmt_count_planes(format);
+
+	for (int plane = 0; plane < h.nb_planes; plane++) {
+		bool chroma = plane == 1 || plane == 2;
+		int shift = chroma ? desc->log2_chroma_h : 0;
+		int height = (f.f->height + (1 << shift) - 1) >> shift;
+		int width = av_image_get_linesize(format, f.f->width, plane);
+
+		h.planes[plane] = hash_plane(f.f->data[plane],
+					     f.f->linesize[plane], width,
+					     height);
+		h.size += (size_t)width * height;
+	}
+
+	h.all = XXH3_64bits(h.planes.data(), h.nb_planes * sizeof(uint64_t));
+
+	return h;
+}
+
+uint64_t hash(const packet &p)
+{
+	AVPacket *pkt = p.p;
+
+	return XXH3_64bits(pkt->data, pkt->size);
+}
+
+static std::string framehash_line(int stream, int64_t pts, size_t size,
+				  uint64_t hash)
+{
+	return fmt::format("{}, {}, {}, {:016x}\n", stream, pts, size, hash);
+}
+
+bool framehash_writer::open(const std::string &path)
+{
+	out.open(path, std::ios::trunc);
+	if (!out) {
+		fmt::print(stderr, "{}: can't open for writing\n", path);
+		return false;
+	}
+
+	out << framehash_header;
+	return !!out;
+}
+
+bool framehash_writer::write(int stream, const frame &f)
+{
+	frame_hash h = hash(f);
+
+	if (h.nb_planes == 0)
+		return false;
+
+	out << framehash_line(stream, f.f->pts, h.size, h.all);
+	return !!out;
+}
+
+bool framehash_writer::operator<<(const packet &p)
+{
+	out << framehash_line(p.stream_index(), p.pts(), p.size(), hash(p));
+	return !!out;
+}
+
+bool framehash_checker::open(const std::string &path)
+{
+	in.open(path);
+	if (!in) {
+		fmt::print(stderr, "{}: can't open\n", path);
+		return false;
+	}
+
+	line_number = 0;
+	nb_mismatches = 0;
+	return true;
+}
+
+bool framehash_checker::check(int stream, const frame &f)
+{
+	frame_hash h = hash(f);
+
+	if (h.nb_planes == 0)
+		return false;
+
+	return check(framehash_line(stream, f.f->pts, h.size, h.all));
+}
+
+bool framehash_checker::operator<<(const packet &p)
+{
+	return check(
+	    framehash_line(p.stream_index(), p.pts(), p.size(), hash(p)));
+}
+
+bool framehash_checker::finish()
+{
+	std::string line;
+
+	if (next(line)) {
+		fmt::print(stderr, "framehash: line {} never matched\n",
+			   line_number);
+		nb_mismatches++;
+	}
+
+	return nb_mismatches == 0;
+}
+
+bool framehash_checker::check(const std::string &line)
+{
+	std::string expected;
+
+	if (!next(expected))
+		expected = "end of file\n";
+	else
+		expected += "\n";
+
+	if (expected == line)
+		return true;
+
+	// the first one tells where the output started to diverge
+	if (nb_mismatches++ == 0)
+		fmt::print(stderr, "framehash: line {}: expected {}got {}",
+			   line_number, expected, line);
+
+	return false;
+}
+
+bool framehash_checker::next(std::string &line)
+{
+	while (std::getline(in, line)) {
+		line_number++;
+
+		if (!line.empty() && line[0] != '#')
+			return true;
+	}
+	return false;
+}
+
+} // namespace av
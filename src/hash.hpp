@@ -0,0 +1,77 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <array>
+#include <fstream>
+
+namespace av
+{
+
+/*
+ * XXH3 64-bit digests of the visible bytes of a software video frame: rows
+ * are hashed without their linesize padding, so the same picture gives the
+ * same hash whatever the buffer layout. all combines the plane hashes.
+ * nb_planes is 0 for frames that can't be hashed (hardware, paletted).
+ */
+struct frame_hash {
+	int nb_planes;
+	std::array<uint64_t, 4> planes;
+	uint64_t all;
+	size_t size;
+};
+
+frame_hash hash(const frame &f);
+uint64_t hash(const packet &p);
+
+/*
+ * Text checksums of a stream of frames or packets, one line each with the
+ * stream, pts, size and hash, like the ffmpeg framehash muxer. A file
+ * written once is the golden reference later runs are checked against.
+ */
+class framehash_writer
+{
+public:
+	framehash_writer() {}
+
+	bool open(const std::string &path);
+
+	bool write(int stream, const frame &f);
+	bool operator<<(const packet &p);
+
+private:
+	framehash_writer(const framehash_writer &) = delete;
+	framehash_writer &operator=(const framehash_writer &) = delete;
+
+	std::ofstream out;
+};
+
+/*
+ * Reads a framehash file and checks frames or packets against it in
+ * order. The first mismatch is reported on stderr, finish() tells whether
+ * every line of the reference was matched.
+ */
+class framehash_checker
+{
+public:
+	framehash_checker() : line_number(0), nb_mismatches(0) {}
+
+	bool open(const std::string &path);
+
+	bool check(int stream, const frame &f);
+	bool operator<<(const packet &p);
+
+	bool finish();
+
+	size_t mismatches() const { return nb_mismatches; }
+
+private:
+	framehash_checker(const framehash_checker &) = delete;
+	framehash_checker &operator=(const framehash_checker &) = delete;
+
+	bool check(const std::string &line);
+	bool next(std::string &line);
+
+	std::ifstream in;
+	size_t line_number, nb_mismatches;
+};
+
+} // namespace av
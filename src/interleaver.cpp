@@ -0,0 +1,220 @@
+#include "interleaver.hpp"
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+namespace av
+{
+
+bool interleaver::source::push(AVPacket *packet)
+{
+	size_t t = tail.load(std::memory_order_relaxed);
+
+	if (t - head.load(std::memory_order_acquire) == slots.size())
+		return false;
+
+	slots[t % slots.size()] = packet;
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+AVPacket *interleaver::source::pop()
+{
+	size_t h = head.load(std::memory_order_relaxed);
+
+	if (h == tail.load(std::memory_order_acquire))
+		return nullptr;
+
+	AVPacket *packet = slots[h % slots.size()];
+
+	head.store(h + 1, std::memory_order_release);
+	head.notify_one();
+	return packet;
+}
+
+interleaver::interleaver(output &o, int nb_sources, int64_t max_delay,
+			 size_t queue_size)
+    : out(o), max_delay(max_delay), t0(AV_NOPTS_VALUE), events(0),
+      failed(false), nb_written(0), nb_late(0), seq(0), newest(INT64_MIN),
+      last_written(INT64_MIN)
+{
+	for (int i = 0; i < nb_sources; i++) {
+		auto s = std::make_unique<source>(queue_size);
+
+		s->finished = false;
+		s->offset = 0;
+		s->last = INT64_MIN;
+		s->done = false;
+
+		sources.push_back(std::move(s));
+	}
+
+	time_bases = out.time_bases;
+
+	writer = std::thread(&interleaver::run, this);
+}
+
+void interleaver::align(int source, int64_t start_time_realtime)
+{
+	int64_t expected = AV_NOPTS_VALUE;
+
+	if (source < 0 || (size_t)source >= sources.size())
+		return;
+
+	// the first source aligned is the wallclock reference
+	if (t0.compare_exchange_strong(expected, start_time_realtime))
+		expected = start_time_realtime;
+
+	sources[source]->offset = start_time_realtime - expected;
+}
+
+bool interleaver::submit(int index, const packet &p)
+{
+	AVPacket *packet;
+
+	if (failed)
+		return false;
+
+	if (index < 0 || (size_t)index >= sources.size() ||
+	    (size_t)p.stream_index() >= time_bases.size()) {
+		fmt::print(stderr,
+			   "interleaver: invalid source {} or stream {}\n",
+			   index, p.stream_index());
+		return false;
+	}
+
+	source &s = *sources[index];
+
+	packet = av_packet_alloc();
+	if (av_packet_ref(packet, p.p) < 0) {
+		av_packet_free(&packet);
+		return false;
+	}
+
+	if (s.offset) {
+		AVRational tb = time_bases[packet->stream_index];
+		int64_t delta = av_rescale_q(s.offset, AV_TIME_BASE_Q, tb);
+
+		if (packet->pts != AV_NOPTS_VALUE)
+			packet->pts += delta;
+		if (packet->dts != AV_NOPTS_VALUE)
+			packet->dts += delta;
+	}
+
+	// a full ring blocks the producer until the writer pops from it
+	while (true) {
+		size_t head = s.head.load(std::memory_order_acquire);
+
+		if (s.push(packet))
+			break;
+
+		if (failed) {
+			av_packet_free(&packet);
+			return false;
+		}
+
+		s.head.wait(head, std::memory_order_acquire);
+	}
+
+	events.fetch_add(1, std::memory_order_release);
+	events.notify_one();
+	return true;
+}
+
+void interleaver::finish(int source)
+{
+	if (source < 0 || (size_t)source >= sources.size())
+		return;
+
+	sources[source]->finished = true;
+
+	events.fetch_add(1, std::memory_order_release);
+	events.notify_one();
+}
+
+void interleaver::close()
+{
+	if (!writer.joinable())
+		return;
+
+	for (size_t i = 0; i < sources.size(); i++)
+		finish(i);
+
+	writer.join();
+}
+
+int64_t interleaver::key(const AVPacket *packet) const
+{
+	int64_t ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+
+	if (ts == AV_NOPTS_VALUE)
+		return newest == INT64_MIN ? 0 : newest;
+
+	return av_rescale_q(ts, time_bases[packet->stream_index],
+			    AV_TIME_BASE_Q);
+}
+
+bool interleaver::ready(const entry &e) const
+{
+	if (e.key + max_delay <= newest)
+		return true;
+
+	for (auto &s : sources)
+		if (!s->done && s->last < e.key)
+			return false;
+
+	return true;
+}
+
+void interleaver::run()
+{
+	while (true) {
+		uint64_t seen = events.load(std::memory_order_acquire);
+		bool progress = false, finished = true;
+
+		for (auto &s : sources) {
+			bool fin = s->finished;
+			AVPacket *packet;
+
+			while ((packet = s->pop())) {
+				entry e{key(packet), seq++, packet};
+
+				s->last = e.key;
+				newest = std::max(newest, e.key);
+
+				heap.push_back(e);
+				std::push_heap(heap.begin(), heap.end());
+				progress = true;
+			}
+
+			s->done = fin;
+			finished &= fin;
+		}
+
+		while (!heap.empty() && ready(heap.front())) {
+			std::pop_heap(heap.begin(), heap.end());
+			entry e = heap.back();
+			heap.pop_back();
+
+			if (e.key < last_written)
+				nb_late++;
+			last_written = std::max(last_written, e.key);
+
+			if (!failed && out.write(e.packet, true, false) < 0)
+				failed = true;
+
+			av_packet_free(&e.packet);
+			nb_written++;
+		}
+
+		if (finished && heap.empty())
+			break;
+
+		if (!progress)
+			events.wait(seen, std::memory_order_acquire);
+	}
+}
+
+} // namespace av
@@ -0,0 +1,88 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace av
+{
+
+/*
+ * Orders the packets of several producer threads before writing them to an
+ * output. Each source is fed by one thread through its own lock-free ring;
+ * a writer thread merges them on their dts, in microseconds, and writes a
+ * packet once every source has gone past it or once it is older than
+ * max_delay compared to the newest packet. submit() blocks while the ring
+ * of its source is full. Packet stream indexes and timestamps are the ones
+ * of the output streams (see output::time_base()).
+ */
+class interleaver
+{
+public:
+	interleaver(output &out, int nb_sources,
+		    int64_t max_delay = AV_TIME_BASE, size_t queue_size = 256);
+	~interleaver() { close(); }
+
+	void align(int source, int64_t start_time_realtime);
+	bool submit(int source, const packet &p);
+	void finish(int source);
+	void close();
+
+	uint64_t written() const { return nb_written; }
+	uint64_t late() const { return nb_late; }
+
+private:
+	interleaver(const interleaver &) = delete;
+	interleaver &operator=(const interleaver &) = delete;
+
+	struct source {
+		source(size_t size) : slots(size), head(0), tail(0) {}
+
+		bool push(AVPacket *packet);
+		AVPacket *pop();
+
+		// single producer, single consumer ring
+		std::vector<AVPacket *> slots;
+		std::atomic<size_t> head, tail;
+		std::atomic<bool> finished;
+
+		// producer side
+		int64_t offset;
+
+		// writer side
+		int64_t last;
+		bool done;
+	};
+
+	struct entry {
+		int64_t key;
+		uint64_t seq;
+		AVPacket *packet;
+
+		bool operator<(const entry &o) const
+		{
+			return key > o.key || (key == o.key && seq > o.seq);
+		}
+	};
+
+	void run();
+	int64_t key(const AVPacket *packet) const;
+	bool ready(const entry &e) const;
+
+	output &out;
+	int64_t max_delay;
+	std::vector<std::unique_ptr<source>> sources;
+	std::vector<AVRational> time_bases;
+	std::atomic<int64_t> t0;
+	std::atomic<uint64_t> events;
+	std::atomic<bool> failed;
+	std::atomic<uint64_t> nb_written, nb_late;
+
+	std::vector<entry> heap;
+	uint64_t seq;
+	int64_t newest, last_written;
+	std::thread writer;
+};
+
+} // namespace av
@@ -0,0 +1,131 @@
+#include "job_engine.hpp"
+
+namespace av
+{
+
+frame::scaler &job_context::scaler(AVPixelFormat format, int width,
+				   int height)
+{
+	auto &s = scalers[std::make_tuple(format, width, height)];
+
+	if (!s)
+		s = std::make_unique<frame::scaler>(format, width, height);
+
+	return *s;
+}
+
+std::string job_context::codec_options(const std::string &options) const
+{
+	if (options.find("threads=") != std::string::npos)
+		return options;
+
+	if (options.empty())
+		return fmt::format("threads={}", threads);
+
+	return fmt::format("{}:threads={}", options, threads);
+}
+
+bool job_context::cancelled() const { return cancel && *cancel; }
+
+job_engine::job_engine(size_t nb_workers, size_t max_open_files)
+    : files(max_open_files), next_id(0), nb_unfinished(0), nb_succeeded(0),
+      nb_failed(0), nb_cancelled(0), pool(nb_workers)
+{
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	int threads = std::max<int>(1, cores / pool.size());
+
+	for (size_t i = 0; i < pool.size(); i++)
+		contexts.push_back(
+		    std::unique_ptr<job_context>(new job_context(threads)));
+}
+
+job_engine::~job_engine() { wait(); }
+
+uint64_t job_engine::submit(job j, int priority)
+{
+	uint64_t id;
+
+	{
+		std::lock_guard<std::mutex> l(m);
+
+		id = next_id++;
+		jobs.push({priority, id, std::move(j)});
+		flags[id] = std::make_shared<std::atomic<bool>>(false);
+		nb_unfinished++;
+	}
+
+	// whichever worker runs this picks the best job pending at that time
+	pool.submit([this]() { run(); });
+
+	return id;
+}
+
+bool job_engine::cancel(uint64_t id)
+{
+	std::lock_guard<std::mutex> l(m);
+	auto it = flags.find(id);
+
+	if (it == flags.end())
+		return false;
+
+	*it->second = true;
+	return true;
+}
+
+void job_engine::cancel_all()
+{
+	std::lock_guard<std::mutex> l(m);
+
+	for (auto &f : flags)
+		*f.second = true;
+}
+
+void job_engine::wait()
+{
+	std::unique_lock<std::mutex> l(m);
+
+	done.wait(l, [this]() { return nb_unfinished == 0; });
+}
+
+void job_engine::run()
+{
+	job_context &ctx = *contexts[pool.worker_index()];
+	std::shared_ptr<std::atomic<bool>> flag;
+	pending p;
+	bool ok = false;
+
+	{
+		std::lock_guard<std::mutex> l(m);
+
+		p = jobs.top();
+		jobs.pop();
+		flag = flags[p.id];
+	}
+
+	if (!*flag) {
+		files.acquire();
+
+		ctx.cancel = flag.get();
+		ok = p.j(ctx);
+		ctx.cancel = nullptr;
+
+		files.release();
+	}
+
+	if (*flag)
+		nb_cancelled++;
+	else if (ok)
+		nb_succeeded++;
+	else
+		nb_failed++;
+
+	{
+		std::lock_guard<std::mutex> l(m);
+
+		flags.erase(p.id);
+		nb_unfinished--;
+	}
+	done.notify_all();
+}
+
+} // namespace av
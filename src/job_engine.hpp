@@ -0,0 +1,105 @@
+#pragma once
+#include "codec_pool.hpp"
+#include "ffmpeg.hpp"
+#include "thread_pool.hpp"
+#include <map>
+#include <queue>
+#include <semaphore>
+#include <tuple>
+
+namespace av
+{
+
+class job_engine;
+
+/*
+ * State a worker of the job engine keeps from one job to the next: warm
+ * codec contexts, scalers, and the number of threads the codecs opened by
+ * a job should use so that workers times codec threads fits the machine.
+ */
+class job_context
+{
+public:
+	codec_pool codecs;
+
+	frame::scaler &scaler(AVPixelFormat format, int width, int height);
+	std::string codec_options(const std::string &options = "") const;
+
+	int codec_threads() const { return threads; }
+	bool cancelled() const;
+
+	friend class job_engine;
+
+private:
+	job_context(int threads) : threads(threads), cancel(nullptr) {}
+	job_context(const job_context &) = delete;
+	job_context &operator=(const job_context &) = delete;
+
+	int threads;
+	const std::atomic<bool> *cancel;
+	std::map<std::tuple<AVPixelFormat, int, int>,
+		 std::unique_ptr<frame::scaler>>
+	    scalers;
+};
+
+/*
+ * Runs independent jobs, typically one input -> decoder -> encoder ->
+ * output file each, on a work-stealing thread pool. Higher priorities run
+ * first, jobs can be cancelled before or while they run (a running job
+ * polls job_context::cancelled()), and at most max_open_files jobs run at
+ * once so that the file descriptors stay bounded.
+ */
+class job_engine
+{
+public:
+	using job = std::function<bool(job_context &)>;
+
+	explicit job_engine(size_t nb_workers = 0, size_t max_open_files = 64);
+	~job_engine();
+
+	uint64_t submit(job j, int priority = 0);
+	bool cancel(uint64_t id);
+	void cancel_all();
+	void wait();
+
+	size_t succeeded() const { return nb_succeeded; }
+	size_t failed() const { return nb_failed; }
+	size_t cancelled() const { return nb_cancelled; }
+
+private:
+	job_engine(const job_engine &) = delete;
+	job_engine &operator=(const job_engine &) = delete;
+
+	struct pending {
+		int priority;
+		uint64_t id;
+		job j;
+
+		bool operator<(const pending &o) const
+		{
+			// std::priority_queue pops the largest, FIFO on ties
+			if (priority != o.priority)
+				return priority < o.priority;
+			return id > o.id;
+		}
+	};
+
+	void run();
+
+	std::vector<std::unique_ptr<job_context>> contexts;
+	std::counting_semaphore<> files;
+
+	std::mutex m;
+	std::condition_variable done;
+	std::priority_queue<pending> jobs;
+	std::map<uint64_t, std::shared_ptr<std::atomic<bool>>> flags;
+	uint64_t next_id;
+	size_t nb_unfinished;
+
+	std::atomic<size_t> nb_succeeded, nb_failed, nb_cancelled;
+
+	// last, the workers stop before the state they use goes away
+	thread_pool pool;
+};
+
+} // namespace av
@@ -0,0 +1,99 @@
+#include "load_shedder.hpp"
+
+namespace av
+{
+
+// overloaded packets in a row before going up a level
+static const int patience = 8;
+// eased packets in a row before going down a level, slower on purpose
+static const int recovery = 64;
+
+load_shedder::load_shedder(decoder &dec, AVRational frame_rate,
+			   size_t high_water, size_t low_water)
+    : dec(dec), budget(0), decode_time(0), high_water(high_water),
+      low_water(low_water), pressure(0), calm(0), dropping(false),
+      pending(shed_level::none), current(shed_level::none), nb_dropped(0)
+{
+	// without a frame rate only the queue depth counts
+	if (frame_rate.num > 0 && frame_rate.den > 0)
+		budget = av_q2d(av_inv_q(frame_rate));
+}
+
+bool load_shedder::admit(const packet &p, size_t queue_depth)
+{
+	bool slow = budget > 0 && decode_time > budget;
+	bool fast = budget == 0 || decode_time < budget * 0.75;
+	shed_level level = pending, applied = current;
+
+	// an empty packet flushes the decoder, it is never dropped
+	if (p.size() == 0)
+		return true;
+
+	if (queue_depth >= high_water || slow) {
+		calm = 0;
+		if (++pressure >= patience && level != shed_level::gop) {
+			pending = (shed_level)((int)level + 1);
+			pressure = 0;
+		}
+	} else if (queue_depth <= low_water && fast) {
+		pressure = 0;
+		if (++calm >= recovery && level != shed_level::none) {
+			pending = (shed_level)((int)level - 1);
+			calm = 0;
+		}
+	} else {
+		pressure = 0;
+		calm = 0;
+	}
+
+	/*
+	 * shedding more applies right away, shedding less waits for a
+	 * keyframe: mid-GOP the decoder would get frames whose references
+	 * it skipped
+	 */
+	if (pending > applied || (pending < applied && p.is_keyframe()))
+		set_level(pending);
+
+	/*
+	 * a GOP is dropped or decoded as a whole, decided on its keyframe:
+	 * dropped while the backlog is not absorbed
+	 */
+	if (p.is_keyframe())
+		dropping =
+		    current == shed_level::gop && queue_depth > low_water;
+	else if (current == shed_level::gop)
+		dropping = true;
+
+	// a dropped packet costs no decoding time
+	if (dropping) {
+		nb_dropped++;
+		decoded(0);
+	}
+
+	return !dropping;
+}
+
+void load_shedder::decoded(double seconds)
+{
+	decode_time += (seconds - decode_time) / 8;
+}
+
+void load_shedder::set_level(shed_level level)
+{
+	switch (level) {
+	case shed_level::none:
+		dec.discard(AVDISCARD_DEFAULT);
+		break;
+	case shed_level::nonref:
+		dec.discard(AVDISCARD_NONREF);
+		break;
+	case shed_level::keyframes:
+	case shed_level::gop:
+		dec.discard(AVDISCARD_NONKEY);
+		break;
+	}
+
+	current = level;
+}
+
+} // namespace av
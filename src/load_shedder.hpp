@@ -0,0 +1,53 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <atomic>
+
+namespace av
+{
+
+/*
+ * Shedding levels, each one dropping more than the previous: non-reference
+ * frames are skipped by the decoder, then everything but keyframes, then
+ * whole GOPs are dropped before reaching the decoder.
+ */
+enum class shed_level { none, nonref, keyframes, gop };
+
+/*
+ * Overload controller of a live decoder. The consumer calls admit() with
+ * the depth of its input queue before decoding each packet, and decoded()
+ * with the time it took. When the queue stays above high_water or decoding
+ * a packet takes longer than a frame interval, the level goes up one step;
+ * it goes back down one step at a time once the queue is under low_water
+ * and decoding is fast again for a while, each step taking effect on the
+ * next keyframe. Empty packets, which flush the decoder, are always
+ * admitted. level() can be read from any thread.
+ */
+class load_shedder
+{
+public:
+	load_shedder(decoder &dec, AVRational frame_rate,
+		     size_t high_water = 16, size_t low_water = 4);
+
+	bool admit(const packet &p, size_t queue_depth);
+	void decoded(double seconds);
+
+	shed_level level() const { return current; }
+	uint64_t dropped() const { return nb_dropped; }
+
+private:
+	load_shedder(const load_shedder &) = delete;
+	load_shedder &operator=(const load_shedder &) = delete;
+
+	void set_level(shed_level level);
+
+	decoder &dec;
+	double budget, decode_time;
+	size_t high_water, low_water;
+	int pressure, calm;
+	bool dropping;
+	shed_level pending;
+	std::atomic<shed_level> current;
+	std::atomic<uint64_t> nb_dropped;
+};
+
+} // namespace av
@@ -0,0 +1,189 @@
+#include "memory_budget.hpp"
+
+namespace av
+{
+
+namespace
+{
+
+struct charged_buffer {
+	memory_budget *budget;
+	AVBufferRef *buf;
+	size_t size;
+};
+
+}
+
+memory_budget::memory_budget(size_t limit, overflow policy,
+			     memory_budget *parent)
+    : parent(parent), policy(policy), max_bytes(limit), bytes(0),
+      peak_bytes(0), nb_shed(0)
+{
+}
+
+memory_budget &memory_budget::process()
+{
+	static memory_budget budget(0, overflow::block, nullptr);
+
+	return budget;
+}
+
+void memory_budget::set_limit(size_t limit, overflow policy)
+{
+	{
+		std::lock_guard<std::mutex> l(m);
+
+		max_bytes = limit;
+		this->policy = policy;
+	}
+	cv.notify_all();
+}
+
+bool memory_budget::charge(AVPacket *packet)
+{
+	AVBufferRef *wrapped;
+
+	if (!packet->buf && av_packet_make_refcounted(packet) < 0)
+		return true;
+
+	if (!reserve(packet->buf->size))
+		return false;
+
+	wrapped = wrap(packet->buf);
+	if (wrapped)
+		packet->buf = wrapped;
+
+	return true;
+}
+
+bool memory_budget::charge(AVFrame *frame)
+{
+	size_t total = 0;
+
+	// hardware surfaces live in their own pools, leave them alone
+	if (frame->hw_frames_ctx)
+		return true;
+
+	for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++)
+		total += frame->buf[i]->size;
+	for (int i = 0; i < frame->nb_extended_buf; i++)
+		total += frame->extended_buf[i]->size;
+
+	if (!reserve(total))
+		return false;
+
+	for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++) {
+		AVBufferRef *wrapped = wrap(frame->buf[i]);
+
+		if (wrapped)
+			frame->buf[i] = wrapped;
+	}
+	for (int i = 0; i < frame->nb_extended_buf; i++) {
+		AVBufferRef *wrapped = wrap(frame->extended_buf[i]);
+
+		if (wrapped)
+			frame->extended_buf[i] = wrapped;
+	}
+
+	return true;
+}
+
+size_t memory_budget::used() const
+{
+	std::lock_guard<std::mutex> l(m);
+	return bytes;
+}
+
+size_t memory_budget::peak() const
+{
+	std::lock_guard<std::mutex> l(m);
+	return peak_bytes;
+}
+
+size_t memory_budget::limit() const
+{
+	std::lock_guard<std::mutex> l(m);
+	return max_bytes;
+}
+
+size_t memory_budget::shed() const
+{
+	std::lock_guard<std::mutex> l(m);
+	return nb_shed;
+}
+
+bool memory_budget::reserve(size_t size)
+{
+	if (parent && !parent->reserve(size))
+		return false;
+
+	if (!take(size)) {
+		if (parent)
+			parent->release(size);
+		return false;
+	}
+
+	return true;
+}
+
+void memory_budget::release(size_t size)
+{
+	{
+		std::lock_guard<std::mutex> l(m);
+		bytes -= size;
+	}
+	cv.notify_all();
+
+	if (parent)
+		parent->release(size);
+}
+
+bool memory_budget::take(size_t size)
+{
+	std::unique_lock<std::mutex> l(m);
+
+	// a single object larger than the limit still goes through alone
+	while (max_bytes && bytes > 0 && bytes + size > max_bytes) {
+		if (policy == overflow::shed) {
+			nb_shed++;
+			return false;
+		}
+		cv.wait(l);
+	}
+
+	bytes += size;
+	peak_bytes = std::max(peak_bytes, bytes);
+	return true;
+}
+
+/*
+ * Reference the payload through a new buffer whose last unref gives the
+ * bytes back. The original buffer is kept alive by the wrapper.
+ */
+AVBufferRef *memory_budget::wrap(AVBufferRef *buf)
+{
+	auto *c = new charged_buffer{this, buf, buf->size};
+	int flags = av_buffer_is_writable(buf) ? 0 : AV_BUFFER_FLAG_READONLY;
+	AVBufferRef *wrapped;
+
+	wrapped = av_buffer_create(
+	    buf->data, buf->size,
+	    [](void *opaque, uint8_t *) {
+		    auto *c = static_cast<charged_buffer *>(opaque);
+
+		    av_buffer_unref(&c->buf);
+		    c->budget->release(c->size);
+		    delete c;
+	    },
+	    c, flags);
+
+	if (!wrapped) {
+		// keep the original, unaccounted from now on
+		release(c->size);
+		delete c;
+	}
+
+	return wrapped;
+}
+
+} // namespace av
@@ -0,0 +1,60 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <condition_variable>
+#include <mutex>
+
+namespace av
+{
+
+/*
+ * What a source does with a new packet or frame past the budget: wait for
+ * the consumers to release memory, or drop it.
+ */
+enum class overflow { block, shed };
+
+/*
+ * Byte accounting of the payloads referenced by packets and frames. A
+ * charged packet or frame gets its buffers wrapped: the bytes count as
+ * used as long as any reference to them is alive, whatever thread or
+ * queue holds it. Budgets form a tree, every charge also counts in the
+ * parent, by default the process-wide budget. A limit of 0 only
+ * accounts. A budget must outlive the objects it charged.
+ */
+class memory_budget
+{
+public:
+	explicit memory_budget(size_t limit = 0,
+			       overflow policy = overflow::block,
+			       memory_budget *parent = &process());
+	~memory_budget() = default;
+
+	static memory_budget &process();
+
+	void set_limit(size_t limit, overflow policy = overflow::block);
+
+	bool charge(AVPacket *packet);
+	bool charge(AVFrame *frame);
+
+	size_t used() const;
+	size_t peak() const;
+	size_t limit() const;
+	size_t shed() const;
+
+private:
+	memory_budget(const memory_budget &) = delete;
+	memory_budget &operator=(const memory_budget &) = delete;
+
+	bool reserve(size_t bytes);
+	void release(size_t bytes);
+	bool take(size_t bytes);
+	AVBufferRef *wrap(AVBufferRef *buf);
+
+	memory_budget *parent;
+	overflow policy;
+
+	mutable std::mutex m;
+	std::condition_variable cv;
+	size_t max_bytes, bytes, peak_bytes, nb_shed;
+};
+
+} // namespace av
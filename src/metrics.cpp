@@ -0,0 +1,514 @@
+#include "metrics.hpp"
+#include <cmath>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#else
+#define HAVE_X86 0
+#endif
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+namespace av
+{
+
+namespace metrics
+{
+
+struct planes_info {
+	int nb_planes;
+	int depth;
+	std::array<int, 4> width, height;
+	std::array<double, 4> weights;
+};
+
+static bool has_avx2()
+{
+#if HAVE_X86
+	// may run from a static constructor, before the runtime's own
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+static bool use_simd = has_avx2();
+
+void set_simd(bool enable) { use_simd = enable && has_avx2(); }
+
+bool simd() { return use_simd; }
+
+static bool get_planes(const AVFrame *a, const AVFrame *b, planes_info &info)
+{
+	const AVPixFmtDescriptor *desc;
+	double total = 0;
+
+	if (a->format != b->format || a->width != b->width ||
+	    a->height != b->height) {
+		fmt::print(stderr, "metrics: frames format or size differ\n");
+		return false;
+	}
+
+	desc = av_pix_fmt_desc_get((AVPixelFormat)a->format);
+	if (!desc || !(desc->flags & AV_PIX_FMT_FLAG_PLANAR) ||
+	    (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL |
+			    AV_PIX_FMT_FLAG_BE)) ||
+	    desc->comp[0].depth > 16 || a->width < 8 || a->height < 8) {
+		fmt::print(stderr, "metrics: unsupported frames\n");
+		return false;
+	}
+
+	// one component per plane: no interleaved chroma (nv12, p010)
+	info.nb_planes = av_pix_fmt_count_planes((AVPixelFormat)a->format);
+	if (info.nb_planes != desc->nb_components) {
+		fmt::print(stderr, "metrics: unsupported frames\n");
+		return false;
+	}
+
+	info.depth = desc->comp[0].depth;
+
+	for (int i = 0; i < info.nb_planes; i++) {
+		bool chroma = i == 1 || i == 2;
+
+		info.width[i] = chroma ? -((-a->width) >> desc->log2_chroma_w)
+				       : a->width;
+		info.height[i] = chroma
+				     ? -((-a->height) >> desc->log2_chroma_h)
+				     : a->height;
+		total += (double)info.width[i] * info.height[i];
+	}
+
+	for (int i = 0; i < info.nb_planes; i++)
+		info.weights[i] = info.width[i] * info.height[i] / total;
+
+	return true;
+}
+
+/*
+ * sum of squared differences of a row
+ */
+template <typename T>
+static uint64_t sse_row(const T *a, const T *b, int width)
+{
+	uint64_t sse = 0;
+
+	for (int x = 0; x < width; x++) {
+		int64_t d = (int)a[x] - (int)b[x];
+
+		sse += d * d;
+	}
+	return sse;
+}
+
+/*
+ * Sums of a, b, a² + b² and ab of consecutive 4x4 blocks along a row of
+ * blocks, the first pass of the SSIM.
+ */
+template <typename T>
+static void ssim_sums(const T *a, ptrdiff_t a_stride, const T *b,
+		      ptrdiff_t b_stride, std::array<int64_t, 4> *sums,
+		      int width)
+{
+	for (int x = 0; x < width; x++) {
+		int64_t s1 = 0, s2 = 0, ss = 0, s12 = 0;
+
+		for (int y = 0; y < 4; y++) {
+			for (int i = 0; i < 4; i++) {
+				int64_t va = a[4 * x + i + y * a_stride];
+				int64_t vb = b[4 * x + i + y * b_stride];
+
+				s1 += va;
+				s2 += vb;
+				ss += va * va + vb * vb;
+				s12 += va * vb;
+			}
+		}
+
+		sums[x] = {s1, s2, ss, s12};
+	}
+}
+
+#if HAVE_X86
+
+__attribute__((target("avx2"))) static inline __m256i
+load16(const uint8_t *p)
+{
+	return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+load16(const uint16_t *p)
+{
+	return _mm256_loadu_si256((const __m256i *)p);
+}
+
+/*
+ * 16 pixels per iteration; differences and their squares fit the 16 and
+ * 32-bit lanes up to 14 bits
+ */
+template <typename T>
+__attribute__((target("avx2"))) static uint64_t
+sse_row_avx2(const T *a, const T *b, int width)
+{
+	__m256i acc = _mm256_setzero_si256();
+	uint64_t lanes[4];
+	int x;
+
+	for (x = 0; x + 16 <= width; x += 16) {
+		__m256i d = _mm256_sub_epi16(load16(a + x), load16(b + x));
+		__m256i sq = _mm256_madd_epi16(d, d);
+		__m128i lo = _mm256_castsi256_si128(sq);
+		__m128i hi = _mm256_extracti128_si256(sq, 1);
+
+		acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(lo));
+		acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(hi));
+	}
+
+	_mm256_storeu_si256((__m256i *)lanes, acc);
+
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+	       sse_row(a + x, b + x, width - x);
+}
+
+/*
+ * 4 blocks per iteration: 32-bit lanes hold the sums of column pairs over
+ * the 4 rows, horizontal adds make them block sums. Fits up to 12 bits.
+ */
+template <typename T>
+__attribute__((target("avx2"))) static void
+ssim_sums_avx2(const T *a, ptrdiff_t a_stride, const T *b, ptrdiff_t b_stride,
+	       std::array<int64_t, 4> *sums, int width)
+{
+	const __m256i ones = _mm256_set1_epi16(1);
+	int x;
+
+	for (x = 0; x + 4 <= width; x += 4) {
+		__m256i s1 = _mm256_setzero_si256();
+		__m256i s2 = _mm256_setzero_si256();
+		__m256i ss = _mm256_setzero_si256();
+		__m256i s12 = _mm256_setzero_si256();
+
+		for (int y = 0; y < 4; y++) {
+			__m256i va = load16(a + 4 * x + y * a_stride);
+			__m256i vb = load16(b + 4 * x + y * b_stride);
+
+			s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(va, ones));
+			s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(vb, ones));
+			ss = _mm256_add_epi32(ss, _mm256_madd_epi16(va, va));
+			ss = _mm256_add_epi32(ss, _mm256_madd_epi16(vb, vb));
+			s12 = _mm256_add_epi32(s12, _mm256_madd_epi16(va, vb));
+		}
+
+		// per 128-bit lane: s1 and s2 of 2 blocks, ss and s12 of 2
+		__m256i h1 = _mm256_hadd_epi32(s1, s2);
+		__m256i h2 = _mm256_hadd_epi32(ss, s12);
+
+		h1 = _mm256_shuffle_epi32(h1, _MM_SHUFFLE(3, 1, 2, 0));
+		h2 = _mm256_shuffle_epi32(h2, _MM_SHUFFLE(3, 1, 2, 0));
+
+		// blocks 0 and 2, then 1 and 3, as s1, s2, ss, s12
+		__m256i even = _mm256_unpacklo_epi64(h1, h2);
+		__m256i odd = _mm256_unpackhi_epi64(h1, h2);
+
+		_mm256_storeu_si256(
+		    (__m256i *)sums[x].data(),
+		    _mm256_cvtepi32_epi64(_mm256_castsi256_si128(even)));
+		_mm256_storeu_si256(
+		    (__m256i *)sums[x + 1].data(),
+		    _mm256_cvtepi32_epi64(_mm256_castsi256_si128(odd)));
+		_mm256_storeu_si256(
+		    (__m256i *)sums[x + 2].data(),
+		    _mm256_cvtepi32_epi64(_mm256_extracti128_si256(even, 1)));
+		_mm256_storeu_si256(
+		    (__m256i *)sums[x + 3].data(),
+		    _mm256_cvtepi32_epi64(_mm256_extracti128_si256(odd, 1)));
+	}
+
+	ssim_sums(a + 4 * x, a_stride, b + 4 * x, b_stride, sums + x,
+		  width - x);
+}
+
+#endif
+
+template <typename T>
+static uint64_t sse_plane(const AVFrame *a, const AVFrame *b, int plane,
+			  int width, int height, int depth)
+{
+	uint64_t sse = 0;
+
+	for (int y = 0; y < height; y++) {
+		const T *ra = (const T *)(a->data[plane] +
+					  y * a->linesize[plane]);
+		const T *rb = (const T *)(b->data[plane] +
+					  y * b->linesize[plane]);
+
+#if HAVE_X86
+		if (use_simd && depth <= 14) {
+			sse += sse_row_avx2(ra, rb, width);
+			continue;
+		}
+#endif
+		sse += sse_row(ra, rb, width);
+	}
+
+	(void)depth;
+	return sse;
+}
+
+/*
+ * the 8-bit window score in the integer and float arithmetic of
+ * libavfilter, to give the same numbers
+ */
+static float ssim_end8(int s1, int s2, int ss, int s12)
+{
+	static const int c1 = (int)(.01 * .01 * 255 * 255 * 64 + .5);
+	static const int c2 = (int)(.03 * .03 * 255 * 255 * 64 * 63 + .5);
+	int vars = ss * 64 - s1 * s1 - s2 * s2;
+	int covar = s12 * 64 - s1 * s2;
+
+	return (float)(2 * s1 * s2 + c1) * (float)(2 * covar + c2) /
+	       ((float)(s1 * s1 + s2 * s2 + c1) * (float)(vars + c2));
+}
+
+static double ssim_end16(int64_t s1, int64_t s2, int64_t ss, int64_t s12,
+			 int max)
+{
+	int64_t c1 = (int64_t)(.01 * .01 * max * max * 64 + .5);
+	int64_t c2 = (int64_t)(.03 * .03 * max * max * 64 * 63 + .5);
+	int64_t vars = ss * 64 - s1 * s1 - s2 * s2;
+	int64_t covar = s12 * 64 - s1 * s2;
+
+	return (double)(2 * s1 * s2 + c1) * (double)(2 * covar + c2) /
+	       ((double)(s1 * s1 + s2 * s2 + c1) * (double)(vars + c2));
+}
+
+/*
+ * windows of 2x2 blocks from two consecutive rows of block sums
+ */
+template <typename T>
+static double ssim_end_row(const std::array<int64_t, 4> *sum0,
+			   const std::array<int64_t, 4> *sum1, int width,
+			   int max)
+{
+	std::array<int64_t, 4> s;
+	float ssim8 = 0;
+	double ssim16 = 0;
+
+	for (int i = 0; i < width; i++) {
+		for (int k = 0; k < 4; k++)
+			s[k] = sum0[i][k] + sum0[i + 1][k] + sum1[i][k] +
+			       sum1[i + 1][k];
+
+		if (sizeof(T) == 1)
+			ssim8 += ssim_end8(s[0], s[1], s[2], s[3]);
+		else
+			ssim16 += ssim_end16(s[0], s[1], s[2], s[3], max);
+	}
+
+	return sizeof(T) == 1 ? ssim8 : ssim16;
+}
+
+template <typename T>
+static double ssim_plane(const AVFrame *a, const AVFrame *b, int plane,
+			 int width, int height, int depth)
+{
+	ptrdiff_t a_stride = a->linesize[plane] / (int)sizeof(T);
+	ptrdiff_t b_stride = b->linesize[plane] / (int)sizeof(T);
+	const T *pa = (const T *)a->data[plane];
+	const T *pb = (const T *)b->data[plane];
+	int bw = width >> 2, bh = height >> 2;
+	std::vector<std::array<int64_t, 4>> buffer(2 * (bw + 3));
+	std::array<int64_t, 4> *sum0 = buffer.data(), *sum1 = sum0 + bw + 3;
+	double ssim = 0;
+	int z = 0;
+
+	if (bw < 2 || bh < 2)
+		return 1.0;
+
+	for (int y = 1; y < bh; y++) {
+		for (; z <= y; z++) {
+			const T *ra = pa + 4 * z * a_stride;
+			const T *rb = pb + 4 * z * b_stride;
+
+			std::swap(sum0, sum1);
+#if HAVE_X86
+			if (use_simd && depth <= 12) {
+				ssim_sums_avx2(ra, a_stride, rb, b_stride,
+					       sum0, bw);
+				continue;
+			}
+#endif
+			ssim_sums(ra, a_stride, rb, b_stride, sum0, bw);
+		}
+
+		ssim += ssim_end_row<T>(sum0, sum1, bw - 1, (1 << depth) - 1);
+	}
+
+	return ssim / ((double)(bh - 1) * (bw - 1));
+}
+
+static double to_psnr(double mse, int max)
+{
+	return 10.0 * log10((double)max * max / mse);
+}
+
+/*
+ * per-plane mean squared errors
+ */
+static bool plane_mse(const frame &a, const frame &b, planes_info &info,
+		      std::array<double, 4> &mse)
+{
+	if (!get_planes(a.f, b.f, info))
+		return false;
+
+	for (int i = 0; i < info.nb_planes; i++) {
+		int w = info.width[i], h = info.height[i];
+		uint64_t sse;
+
+		if (info.depth <= 8)
+			sse = sse_plane<uint8_t>(a.f, b.f, i, w, h, info.depth);
+		else
+			sse = sse_plane<uint16_t>(a.f, b.f, i, w, h,
+						  info.depth);
+
+		mse[i] = (double)sse / ((double)w * h);
+	}
+
+	return true;
+}
+
+static bool plane_ssim(const frame &a, const frame &b, planes_info &info,
+		       std::array<double, 4> &ssim)
+{
+	if (!get_planes(a.f, b.f, info))
+		return false;
+
+	for (int i = 0; i < info.nb_planes; i++) {
+		int w = info.width[i], h = info.height[i];
+
+		if (info.depth <= 8)
+			ssim[i] = ssim_plane<uint8_t>(a.f, b.f, i, w, h,
+						      info.depth);
+		else
+			ssim[i] = ssim_plane<uint16_t>(a.f, b.f, i, w, h,
+						       info.depth);
+	}
+
+	return true;
+}
+
+score psnr(const frame &distorted, const frame &reference)
+{
+	score s = {0, {}, 0};
+	std::array<double, 4> mse;
+	planes_info info;
+	double all = 0;
+	int max;
+
+	if (!plane_mse(distorted, reference, info, mse))
+		return s;
+
+	max = (1 << info.depth) - 1;
+
+	for (int i = 0; i < info.nb_planes; i++) {
+		s.planes[i] = to_psnr(mse[i], max);
+		all += mse[i] * info.weights[i];
+	}
+	s.nb_planes = info.nb_planes;
+	s.all = to_psnr(all, max);
+
+	return s;
+}
+
+score ssim(const frame &distorted, const frame &reference)
+{
+	score s = {0, {}, 0};
+	planes_info info;
+
+	if (!plane_ssim(distorted, reference, info, s.planes))
+		return s;
+
+	for (int i = 0; i < info.nb_planes; i++)
+		s.all += s.planes[i] * info.weights[i];
+	s.nb_planes = info.nb_planes;
+
+	return s;
+}
+
+accumulator::accumulator() : nb_planes(0), max(0), nb_frames(0)
+{
+	weights.fill(0);
+	mse.fill(0);
+	ssims.fill(0);
+}
+
+bool accumulator::add(const frame &distorted, const frame &reference)
+{
+	std::array<double, 4> frame_mse, frame_ssim;
+	planes_info info;
+
+	if (!plane_mse(distorted, reference, info, frame_mse) ||
+	    !plane_ssim(distorted, reference, info, frame_ssim))
+		return false;
+
+	if (nb_frames && (info.nb_planes != nb_planes ||
+			  (1 << info.depth) - 1 != max)) {
+		fmt::print(stderr, "metrics: frame format changed\n");
+		return false;
+	}
+
+	nb_planes = info.nb_planes;
+	max = (1 << info.depth) - 1;
+	weights = info.weights;
+
+	for (int i = 0; i < nb_planes; i++) {
+		mse[i] += frame_mse[i];
+		ssims[i] += frame_ssim[i];
+	}
+	nb_frames++;
+
+	return true;
+}
+
+score accumulator::psnr() const
+{
+	score s = {0, {}, 0};
+	double all = 0;
+
+	if (!nb_frames)
+		return s;
+
+	for (int i = 0; i < nb_planes; i++) {
+		s.planes[i] = to_psnr(mse[i] / nb_frames, max);
+		all += mse[i] / nb_frames * weights[i];
+	}
+	s.nb_planes = nb_planes;
+	s.all = to_psnr(all, max);
+
+	return s;
+}
+
+score accumulator::ssim() const
+{
+	score s = {0, {}, 0};
+
+	if (!nb_frames)
+		return s;
+
+	for (int i = 0; i < nb_planes; i++) {
+		s.planes[i] = ssims[i] / nb_frames;
+		s.all += s.planes[i] * weights[i];
+	}
+	s.nb_planes = nb_planes;
+
+	return s;
+}
+
+} // namespace metrics
+
+} // namespace av
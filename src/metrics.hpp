@@ -0,0 +1,59 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <array>
+
+namespace av
+{
+
+/*
+ * Full-reference quality metrics between two software frames of the same
+ * planar YUV (or gray) format and size, 8 to 16 bits. They follow the
+ * algorithms of libavfilter's psnr and ssim filters: PSNR of the mean
+ * squared error, SSIM over overlapping 8x8 windows on a 4x4 grid. Rows use
+ * AVX2 kernels when the CPU has them.
+ */
+namespace metrics
+{
+
+/*
+ * Per-plane values and their average weighted by plane size. nb_planes is
+ * 0 when the frames can't be compared.
+ */
+struct score {
+	int nb_planes;
+	std::array<double, 4> planes;
+	double all;
+};
+
+score psnr(const frame &distorted, const frame &reference);
+score ssim(const frame &distorted, const frame &reference);
+
+/*
+ * Streaming comparison, typically of a decoder output against the
+ * reference frames: PSNR of the mean squared error over all frames and
+ * mean SSIM, as the ffmpeg filters report at the end of a stream.
+ */
+class accumulator
+{
+public:
+	accumulator();
+
+	bool add(const frame &distorted, const frame &reference);
+
+	score psnr() const;
+	score ssim() const;
+	size_t frames() const { return nb_frames; }
+
+private:
+	int nb_planes, max;
+	size_t nb_frames;
+	std::array<double, 4> weights, mse, ssims;
+};
+
+// force the scalar kernels, to compare or benchmark them
+void set_simd(bool enable);
+bool simd();
+
+} // namespace metrics
+
+} // namespace av
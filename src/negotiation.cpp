@@ -0,0 +1,133 @@
+#include "negotiation.hpp"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+namespace av
+{
+
+AVPixelFormat negotiate(AVPixelFormat format, const AVCodec *codec)
+{
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+
+	// no list: the encoder takes anything
+	if (!codec->pix_fmts || format == AV_PIX_FMT_NONE)
+		return format;
+
+	for (const AVPixelFormat *p = codec->pix_fmts; *p != AV_PIX_FMT_NONE;
+	     p++)
+		if (*p == format)
+			return format;
+
+	return avcodec_find_best_pix_fmt_of_list(
+	    codec->pix_fmts, format,
+	    desc && (desc->flags & AV_PIX_FMT_FLAG_ALPHA), nullptr);
+}
+
+AVSampleFormat negotiate(AVSampleFormat format, const AVCodec *codec)
+{
+	AVSampleFormat packed = av_get_packed_sample_fmt(format);
+
+	if (!codec->sample_fmts || format == AV_SAMPLE_FMT_NONE)
+		return format;
+
+	for (const AVSampleFormat *s = codec->sample_fmts;
+	     *s != AV_SAMPLE_FMT_NONE; s++)
+		if (*s == format)
+			return format;
+
+	// same sample type, other layout (planar or interleaved)
+	for (const AVSampleFormat *s = codec->sample_fmts;
+	     *s != AV_SAMPLE_FMT_NONE; s++)
+		if (av_get_packed_sample_fmt(*s) == packed)
+			return *s;
+
+	return codec->sample_fmts[0];
+}
+
+std::string negotiate(const decoder &dec, const std::string &codec)
+{
+	const AVCodec *c = avcodec_find_encoder_by_name(codec.c_str());
+	const AVCodecContext *ctx = dec.ctx;
+
+	if (!c || !ctx)
+		return "";
+
+	if (ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+		// hardware frames are downloaded first, in their sw format
+		AVPixelFormat format =
+		    ctx->hw_frames_ctx ? ctx->sw_pix_fmt : ctx->pix_fmt;
+
+		format = negotiate(format, c);
+		if (format == AV_PIX_FMT_NONE)
+			return "";
+
+		return fmt::format("pixel_format={}",
+				   av_get_pix_fmt_name(format));
+	}
+
+	if (ctx->codec_type == AVMEDIA_TYPE_AUDIO) {
+		AVSampleFormat format = negotiate(ctx->sample_fmt, c);
+
+		if (format == AV_SAMPLE_FMT_NONE)
+			return "";
+
+		return fmt::format("request_sample_fmt={}",
+				   av_get_sample_fmt_name(format));
+	}
+
+	return "";
+}
+
+converter::converter(const encoder &enc)
+    : type(enc.ctx->codec_type), pix_fmt(enc.ctx->pix_fmt),
+      width(enc.ctx->width), height(enc.ctx->height),
+      sample_fmt(enc.ctx->sample_fmt), sample_rate(enc.ctx->sample_rate),
+      layout(), nb_passed(0), nb_converted(0)
+{
+	av_channel_layout_copy(&layout, &enc.ctx->ch_layout);
+}
+
+converter::~converter() { av_channel_layout_uninit(&layout); }
+
+bool converter::matches(const frame &f) const
+{
+	if (type == AVMEDIA_TYPE_VIDEO)
+		return f.f->format == pix_fmt && f.f->width == width &&
+		       f.f->height == height;
+
+	return f.f->format == sample_fmt && f.f->sample_rate == sample_rate &&
+	       !av_channel_layout_compare(&f.f->ch_layout, &layout);
+}
+
+frame converter::convert(const frame &f)
+{
+	frame converted;
+
+	if (matches(f)) {
+		nb_passed++;
+		return f;
+	}
+
+	if (type == AVMEDIA_TYPE_VIDEO) {
+		if (!scaler)
+			scaler = std::make_unique<frame::scaler>(
+			    (AVPixelFormat)pix_fmt, width, height);
+
+		converted = scaler->scale(f);
+	} else {
+		if (!resampler)
+			resampler = std::make_unique<frame::resampler>(
+			    (AVSampleFormat)sample_fmt, sample_rate, layout);
+
+		converted = resampler->resample(f);
+	}
+
+	converted.f->pts = f.f->pts;
+	nb_converted++;
+
+	return converted;
+}
+
+} // namespace av
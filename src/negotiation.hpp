@@ -0,0 +1,51 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <memory>
+
+namespace av
+{
+
+/*
+ * Encoder options selecting the format the decoder outputs when the
+ * encoder takes it (pixel_format for video, request_sample_fmt for audio),
+ * the closest one it supports otherwise. To append to the options of
+ * output::add_stream() so that no conversion is needed in between.
+ */
+std::string negotiate(const decoder &dec, const std::string &codec);
+
+AVPixelFormat negotiate(AVPixelFormat format, const AVCodec *codec);
+AVSampleFormat negotiate(AVSampleFormat format, const AVCodec *codec);
+
+/*
+ * Frames in the format of an encoder: frames that already match are
+ * passed by reference, a scaler or a resampler is only created for the
+ * ones that don't, which also covers format changes mid-stream. The pts
+ * is kept.
+ */
+class converter
+{
+public:
+	converter(const encoder &enc);
+	~converter();
+
+	frame convert(const frame &f);
+
+	uint64_t passed() const { return nb_passed; }
+	uint64_t converted() const { return nb_converted; }
+
+private:
+	converter(const converter &) = delete;
+	converter &operator=(const converter &) = delete;
+
+	bool matches(const frame &f) const;
+
+	AVMediaType type;
+	int pix_fmt, width, height;
+	int sample_fmt, sample_rate;
+	AVChannelLayout layout;
+	std::unique_ptr<frame::scaler> scaler;
+	std::unique_ptr<frame::resampler> resampler;
+	uint64_t nb_passed, nb_converted;
+};
+
+} // namespace av
@@ -0,0 +1,170 @@
+#include "packet_analyzer.hpp"
+
+namespace av
+{
+
+packet_analyzer::stream::stream()
+    : parser(nullptr), ctx(nullptr), window(0), window_bytes(0),
+      last_key(AV_NOPTS_VALUE), frames_since_key(0), stats()
+{
+}
+
+packet_analyzer::stream::~stream()
+{
+	av_parser_close(parser);
+	avcodec_free_context(&ctx);
+}
+
+bool packet_analyzer::open(const input &in)
+{
+	for (int i = 0; i < in.nb_streams(); i++)
+		if (!add_stream(in, i))
+			return false;
+
+	return true;
+}
+
+bool packet_analyzer::add_stream(const input &in, int index)
+{
+	const AVCodecParameters *par;
+	auto s = std::make_unique<stream>();
+
+	if (index < 0 || index >= in.nb_streams())
+		return false;
+
+	par = in.ctx->streams[index]->codecpar;
+
+	s->time_base = in.time_base(index);
+	s->window = window / av_q2d(s->time_base);
+
+	// frame types only mean something for video
+	if (par->codec_type == AVMEDIA_TYPE_VIDEO)
+		s->parser = av_parser_init(par->codec_id);
+
+	if (s->parser) {
+		s->ctx = avcodec_alloc_context3(nullptr);
+		if (!s->ctx || avcodec_parameters_to_context(s->ctx, par) < 0)
+			return false;
+
+		// demuxed packets are whole frames, don't split or merge
+		s->parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+	}
+
+	if ((size_t)index >= streams.size())
+		streams.resize(index + 1);
+
+	streams[index] = std::move(s);
+	return true;
+}
+
+bool packet_analyzer::operator<<(const packet &p)
+{
+	unsigned int index = p.p->stream_index;
+	frame_type type;
+	bool key;
+
+	if (index >= streams.size() || !streams[index])
+		return false;
+
+	stream &s = *streams[index];
+
+	type = classify(s, p.p, key);
+	update(s, p.p, type, key);
+
+	return true;
+}
+
+const packet_stats *packet_analyzer::stats(int index) const
+{
+	if (index < 0 || (size_t)index >= streams.size() || !streams[index])
+		return nullptr;
+
+	return &streams[index]->stats;
+}
+
+frame_type packet_analyzer::classify(stream &s, AVPacket *p, bool &key)
+{
+	uint8_t *data;
+	int size;
+
+	key = p->flags & AV_PKT_FLAG_KEY;
+
+	if (!s.parser)
+		return key ? frame_type::i : frame_type::unknown;
+
+	av_parser_parse2(s.parser, s.ctx, &data, &size, p->data, p->size,
+			 p->pts, p->dts, p->pos);
+
+	if (s.parser->key_frame == 1)
+		key = true;
+
+	switch (s.parser->pict_type) {
+	case AV_PICTURE_TYPE_I:
+	case AV_PICTURE_TYPE_SI:
+		return frame_type::i;
+	case AV_PICTURE_TYPE_P:
+	case AV_PICTURE_TYPE_SP:
+		return frame_type::p;
+	case AV_PICTURE_TYPE_B:
+		return frame_type::b;
+	default:
+		return key ? frame_type::i : frame_type::unknown;
+	}
+}
+
+void packet_analyzer::update(stream &s, const AVPacket *p, frame_type type,
+			     bool key)
+{
+	packet_stats &st = s.stats;
+	int64_t ts = p->dts != AV_NOPTS_VALUE ? p->dts : p->pts;
+
+	if (st.packets == 0 || p->size < st.min_size)
+		st.min_size = p->size;
+	if (p->size > st.max_size)
+		st.max_size = p->size;
+
+	st.packets++;
+	st.bytes += p->size;
+	st.types[(int)type]++;
+	st.last_type = type;
+	st.last_size = p->size;
+
+	if (key) {
+		if (st.keyframes > 0) {
+			st.gop = s.frames_since_key;
+			st.mean_gop +=
+			    (st.gop - st.mean_gop) / (double)st.keyframes;
+
+			if (p->pts != AV_NOPTS_VALUE &&
+			    s.last_key != AV_NOPTS_VALUE)
+				st.keyframe_interval =
+				    (p->pts - s.last_key) *
+				    av_q2d(s.time_base);
+		}
+		st.keyframes++;
+		s.last_key = p->pts;
+		s.frames_since_key = 0;
+	}
+	s.frames_since_key++;
+
+	if (ts == AV_NOPTS_VALUE)
+		return;
+
+	s.sizes.emplace_back(ts, p->size);
+	s.window_bytes += p->size;
+
+	while (ts - s.sizes.front().first > s.window) {
+		s.window_bytes -= s.sizes.front().second;
+		s.sizes.pop_front();
+	}
+
+	int64_t span = ts - s.sizes.front().first;
+
+	if (p->duration > 0)
+		span += p->duration;
+
+	if (span > 0)
+		st.bitrate = s.window_bytes * 8 / (span * av_q2d(s.time_base));
+}
+
+} // namespace av
@@ -0,0 +1,75 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <array>
+#include <deque>
+#include <memory>
+
+struct AVCodecParserContext;
+
+namespace av
+{
+
+enum class frame_type { unknown, i, p, b };
+
+/*
+ * Rolling statistics of a stream. bitrate covers the last window seconds,
+ * gop and keyframe_interval the last closed GOP (keyframe to keyframe).
+ */
+struct packet_stats {
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t keyframes;
+	std::array<uint64_t, 4> types;
+	frame_type last_type;
+	int last_size, min_size, max_size;
+	double bitrate;
+	int gop;
+	double mean_gop;
+	double keyframe_interval;
+};
+
+/*
+ * Frame sizes, types, GOP structure and bitrate of demuxed streams without
+ * decoding them. Frame types come from the codec parsers, which only read
+ * the headers (NAL units for h264/hevc), and default to the keyframe flag
+ * of the packets for codecs without one. Packets are not modified.
+ */
+class packet_analyzer
+{
+public:
+	packet_analyzer(double window = 1.0) : window(window) {}
+
+	bool open(const input &in);
+	bool add_stream(const input &in, int index);
+
+	bool operator<<(const packet &p);
+
+	const packet_stats *stats(int index) const;
+
+private:
+	packet_analyzer(const packet_analyzer &) = delete;
+	packet_analyzer &operator=(const packet_analyzer &) = delete;
+
+	struct stream {
+		stream();
+		~stream();
+
+		AVCodecParserContext *parser;
+		AVCodecContext *ctx;
+		AVRational time_base;
+		int64_t window;
+		std::deque<std::pair<int64_t, int>> sizes;
+		uint64_t window_bytes;
+		int64_t last_key;
+		int frames_since_key;
+		packet_stats stats;
+	};
+
+	frame_type classify(stream &s, AVPacket *p, bool &key);
+	void update(stream &s, const AVPacket *p, frame_type type, bool key);
+
+	double window;
+	std::vector<std::unique_ptr<stream>> streams;
+};
+
+} // namespace av
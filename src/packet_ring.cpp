@@ -0,0 +1,166 @@
+#include "packet_ring.hpp"
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+namespace av
+{
+
+packet_ring::packet_ring(const input &in, double seconds, size_t max_bytes)
+    : seconds(seconds), max_bytes(max_bytes), total_bytes(0),
+      last_pts(AV_NOPTS_VALUE)
+{
+	reference = in.get_video_index();
+	if (reference < 0)
+		reference = 0;
+
+	for (int i = 0; i < in.nb_streams(); i++)
+		time_bases.push_back(in.time_base(i));
+
+	offsets.resize(time_bases.size(), 0);
+}
+
+void packet_ring::push(const packet &p)
+{
+	int index = p.stream_index();
+	size_t size = p.size() + sizeof(AVPacket);
+
+	if ((unsigned int)index >= time_bases.size())
+		return;
+
+	std::lock_guard<std::mutex> l(m);
+
+	if (index == reference) {
+		if (p.is_keyframe()) {
+			ring.push_back(gop{{}, 0, p.pts()});
+
+			// the previous GOPs may now be outside the window
+			evict();
+		}
+
+		if (p.pts() != AV_NOPTS_VALUE)
+			last_pts = std::max(last_pts, p.pts());
+	}
+
+	// wait for a keyframe to start recording
+	if (ring.empty())
+		return;
+
+	gop &g = ring.back();
+
+	g.packets.push_back(p);
+	g.bytes += size;
+	total_bytes += size;
+
+	evict();
+
+	// only the current GOP is left: over budget, it is dropped as a whole
+	if (total_bytes > max_bytes) {
+		total_bytes = 0;
+		ring.clear();
+	}
+}
+
+void packet_ring::evict()
+{
+	AVRational tb = time_bases[reference];
+
+	while (ring.size() > 1) {
+		bool over_budget = total_bytes > max_bytes;
+		bool over_duration =
+		    last_pts != AV_NOPTS_VALUE &&
+		    ring[1].start != AV_NOPTS_VALUE &&
+		    (last_pts - ring[1].start) * av_q2d(tb) >= seconds;
+
+		if (!over_budget && !over_duration)
+			break;
+
+		total_bytes -= ring.front().bytes;
+		ring.pop_front();
+	}
+}
+
+bool packet_ring::drain(output &out, const std::vector<int> &stream_map)
+{
+	std::deque<gop> gops;
+
+	{
+		std::lock_guard<std::mutex> l(m);
+
+		gops.swap(ring);
+		total_bytes = 0;
+	}
+
+	if (gops.empty())
+		return true;
+
+	// rebase on the decoding time of the first keyframe
+	const packet &first = gops.front().packets.front();
+	int64_t base = first.dts();
+	AVRational tb = time_bases[first.stream_index()];
+
+	if (base == AV_NOPTS_VALUE)
+		base = first.pts();
+
+	for (size_t i = 0; i < offsets.size(); i++)
+		offsets[i] = av_rescale_q(base, tb, time_bases[i]);
+
+	for (auto &g : gops) {
+		for (auto &p : g.packets) {
+			packet q = p;
+
+			rebase(q);
+
+			if (!stream_map.empty()) {
+				size_t i = q.stream_index();
+
+				if (i >= stream_map.size())
+					continue;
+
+				int index = stream_map[i];
+
+				if (index < 0)
+					continue;
+				q.stream_index(index);
+			}
+
+			if (!(out << q))
+				return false;
+		}
+	}
+	return true;
+}
+
+void packet_ring::rebase(packet &p) const
+{
+	if ((unsigned int)p.stream_index() < offsets.size())
+		p.add_delta_pts(-offsets[p.stream_index()]);
+}
+
+size_t packet_ring::bytes() const
+{
+	std::lock_guard<std::mutex> l(m);
+
+	return total_bytes;
+}
+
+size_t packet_ring::gops() const
+{
+	std::lock_guard<std::mutex> l(m);
+
+	return ring.size();
+}
+
+double packet_ring::duration() const
+{
+	std::lock_guard<std::mutex> l(m);
+
+	if (ring.empty() || last_pts == AV_NOPTS_VALUE)
+		return 0;
+
+	return (last_pts - ring.front().start) *
+	       av_q2d(time_bases[reference]);
+}
+
+} // namespace av
@@ -0,0 +1,59 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace av
+{
+
+/*
+ * Pre-event recorder: keeps the last `seconds` of packets of an input, in
+ * whole GOPs of its video stream, bounded by `max_bytes`. Packets are held
+ * by reference. drain() writes them to an output with timestamps rebased
+ * on the first kept packet, rebase() applies the same offset to the live
+ * packets written after it.
+ *
+ * max_bytes bounds this ring only, whatever the number of streams of the
+ * input it holds: rings of several inputs don't share it, each one is
+ * given its part of the total to keep.
+ */
+class packet_ring
+{
+public:
+	packet_ring(const input &in, double seconds, size_t max_bytes);
+
+	void push(const packet &p);
+
+	bool drain(output &out, const std::vector<int> &stream_map = {});
+	void rebase(packet &p) const;
+
+	size_t bytes() const;
+	size_t gops() const;
+	double duration() const;
+
+private:
+	packet_ring(const packet_ring &) = delete;
+	packet_ring &operator=(const packet_ring &) = delete;
+
+	struct gop {
+		std::vector<packet> packets;
+		size_t bytes;
+		int64_t start;
+	};
+
+	void evict();
+
+	double seconds;
+	size_t max_bytes;
+	int reference;
+	std::vector<AVRational> time_bases;
+	std::vector<int64_t> offsets;
+
+	mutable std::mutex m;
+	std::deque<gop> ring;
+	size_t total_bytes;
+	int64_t last_pts;
+};
+
+} // namespace av
@@ -0,0 +1,97 @@
+#include "parallel.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace av
+{
+
+namespace
+{
+
+/*
+ * shared with the helper tasks, which may start after the call returned:
+ * band is only used while chunks are left
+ */
+struct parallel_state {
+	std::atomic<int> next;
+	std::atomic<int> done;
+	int count, grain, chunks;
+	const std::function<void(int, int)> *band;
+
+	void work()
+	{
+		int chunk;
+
+		while ((chunk = next++) < chunks) {
+			int begin = chunk * grain;
+
+			(*band)(begin, std::min(begin + grain, count));
+			done++;
+		}
+	}
+};
+
+}
+
+void parallel_for(int count, int grain,
+		  const std::function<void(int, int)> &band, thread_pool &pool)
+{
+	auto state = std::make_shared<parallel_state>();
+	int helpers;
+
+	if (count <= 0)
+		return;
+
+	grain = std::max(grain, 1);
+
+	state->next = 0;
+	state->done = 0;
+	state->count = count;
+	state->grain = grain;
+	state->chunks = (count + grain - 1) / grain;
+	state->band = &band;
+
+	helpers = std::min<int>(state->chunks, pool.size()) - 1;
+	for (int i = 0; i < helpers; i++)
+		pool.submit([state]() { state->work(); });
+
+	state->work();
+
+	// help with other tasks while the last chunks finish
+	while (state->done < state->chunks)
+		if (!pool.run_one())
+			std::this_thread::yield();
+}
+
+bool plane_size(const AVFrame *f, int plane, int &bytes, int &rows)
+{
+	const AVPixFmtDescriptor *desc;
+
+	desc = av_pix_fmt_desc_get((AVPixelFormat)f->format);
+	if (!desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) ||
+	    plane < 0 || plane >= AV_NUM_DATA_POINTERS || !f->data[plane])
+		return false;
+
+	bytes = av_image_get_linesize((AVPixelFormat)f->format, f->width,
+				      plane);
+	if (bytes < 0)
+		return false;
+
+	rows = f->height;
+	if ((plane == 1 || plane == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB))
+		rows = -((-f->height) >> desc->log2_chroma_h);
+
+	return true;
+}
+
+int band_rows(int linesize)
+{
+	return std::max(1, (64 << 10) / std::max(std::abs(linesize), 1));
+}
+
+} // namespace av
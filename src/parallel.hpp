@@ -0,0 +1,88 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include "thread_pool.hpp"
+#include <span>
+
+namespace av
+{
+
+/*
+ * Call band(begin, end) over [0, count) in chunks of grain items, spread
+ * on the pool. The calling thread takes chunks too and returns once all of
+ * them are done.
+ */
+void parallel_for(int count, int grain,
+		  const std::function<void(int, int)> &band,
+		  thread_pool &pool = thread_pool::shared());
+
+/*
+ * Bytes per row and number of rows of a plane of a software frame,
+ * chroma subsampling included. False for a plane the frame doesn't have.
+ */
+bool plane_size(const AVFrame *f, int plane, int &bytes, int &rows);
+
+/*
+ * Rows of one plane in a band of about 64KiB, enough to amortize a task
+ * and small enough to stay in the cache of the core working on it.
+ */
+int band_rows(int linesize);
+
+/*
+ * Run kernel(row, y) on every row of a plane of the frame, rows split in
+ * bands over the pool. The writable version first makes the frame
+ * writable, copying it when shared.
+ */
+template <typename K>
+bool parallel_for_rows(frame &f, int plane, K kernel,
+		       thread_pool &pool = thread_pool::shared())
+{
+	int bytes, rows;
+
+	if (!plane_size(f.f, plane, bytes, rows))
+		return false;
+
+	if (av_frame_make_writable(f.f) < 0)
+		return false;
+
+	uint8_t *data = f.f->data[plane];
+	int linesize = f.f->linesize[plane];
+
+	parallel_for(
+	    rows, band_rows(linesize),
+	    [&](int begin, int end) {
+		    for (int y = begin; y < end; y++)
+			    kernel(std::span<uint8_t>(data + y * linesize,
+						      bytes),
+				   y);
+	    },
+	    pool);
+
+	return true;
+}
+
+template <typename K>
+bool parallel_for_rows(const frame &f, int plane, K kernel,
+		       thread_pool &pool = thread_pool::shared())
+{
+	int bytes, rows;
+
+	if (!plane_size(f.f, plane, bytes, rows))
+		return false;
+
+	const uint8_t *data = f.f->data[plane];
+	int linesize = f.f->linesize[plane];
+
+	parallel_for(
+	    rows, band_rows(linesize),
+	    [&](int begin, int end) {
+		    for (int y = begin; y < end; y++)
+			    kernel(std::span<const uint8_t>(
+				       data + y * linesize, bytes),
+				   y);
+	    },
+	    pool);
+
+	return true;
+}
+
+} // namespace av
@@ -0,0 +1,191 @@
+#include "parallel_encoder.hpp"
+
+namespace av
+{
+
+bool parallel_encoder::open(output &out, const std::string &codec,
+			    const std::string &options, size_t nb_instances)
+{
+	const AVCodecDescriptor *desc;
+	const AVCodec *c;
+	std::string opts = options;
+	encoder first;
+
+	flush();
+
+	c = avcodec_find_encoder_by_name(codec.c_str());
+	if (!c)
+		return false;
+
+	desc = avcodec_descriptor_get(c->id);
+	if (!desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY)) {
+		fmt::print(stderr, "{} is not an intra-only codec\n", codec);
+		return false;
+	}
+
+	if (nb_instances == 0)
+		nb_instances =
+		    std::max(1u, std::thread::hardware_concurrency());
+
+	// the parallelism is across instances
+	if (opts.find("threads=") == std::string::npos)
+		opts += opts.empty() ? "threads=1" : ":threads=1";
+
+	/*
+	 * each instance keeps its coder state across its own frames until a
+	 * keyframe: with interleaved instances every frame must be one, so
+	 * this overrides any gop size given in the options
+	 */
+	opts += ":g=1";
+
+	first = out.add_stream(codec, opts);
+	if (!first)
+		return false;
+
+	this->out = &out;
+	failed = false;
+	next = 0;
+
+	for (size_t i = 0; i < nb_instances; i++) {
+		encoder enc;
+
+		if (i == 0)
+			enc = std::move(first);
+		else {
+			bool global_header = instances[0]->enc.ctx->flags &
+					     AV_CODEC_FLAG_GLOBAL_HEADER;
+
+			enc = encoder::open(codec, opts, global_header);
+			if (!enc)
+				break;
+
+			enc.stream_index = instances[0]->enc.stream_index;
+		}
+
+		instances.push_back(
+		    std::make_unique<instance>(std::move(enc), queue_size));
+	}
+
+	for (auto &i : instances)
+		i->worker = std::thread(&parallel_encoder::run, this,
+					std::ref(*i));
+
+	return true;
+}
+
+bool parallel_encoder::operator<<(const frame &f)
+{
+	if (instances.empty() || failed)
+		return false;
+
+	if (f.f->pts == AV_NOPTS_VALUE) {
+		fmt::print(stderr, "parallel_encoder: frames need a pts\n");
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> l(m);
+		order.push_back(f.f->pts);
+	}
+
+	if (!instances[next]->queue.push(f))
+		return false;
+
+	next = (next + 1) % instances.size();
+
+	write_ready(false);
+	return !failed;
+}
+
+bool parallel_encoder::flush()
+{
+	if (instances.empty())
+		return !failed;
+
+	for (auto &i : instances)
+		i->queue.close();
+
+	for (auto &i : instances)
+		i->worker.join();
+
+	write_ready(true);
+	instances.clear();
+
+	return !failed;
+}
+
+frame parallel_encoder::get_empty_frame()
+{
+	if (instances.empty())
+		return frame();
+
+	return instances[0]->enc.get_empty_frame();
+}
+
+void parallel_encoder::run(instance &i)
+{
+	frame f;
+
+	while (i.queue.pop(f)) {
+		if (!(i.enc << f)) {
+			failed = true;
+			i.queue.close(true);
+			break;
+		}
+		receive(i);
+	}
+
+	i.enc.flush();
+	receive(i);
+}
+
+void parallel_encoder::receive(instance &i)
+{
+	packet p;
+
+	while (i.enc >> p) {
+		std::lock_guard<std::mutex> l(m);
+
+		ready[p.pts()].push_back(p);
+	}
+}
+
+/*
+ * write the packets of the frames pushed first, as long as they are
+ * there; all of them once the workers are done
+ */
+void parallel_encoder::write_ready(bool all)
+{
+	std::vector<packet> packets;
+
+	{
+		std::lock_guard<std::mutex> l(m);
+
+		while (!order.empty()) {
+			auto it = ready.find(order.front());
+
+			if (it == ready.end())
+				break;
+
+			for (auto &p : it->second)
+				packets.push_back(p);
+
+			ready.erase(it);
+			order.pop_front();
+		}
+
+		if (all) {
+			for (auto &r : ready)
+				for (auto &p : r.second)
+					packets.push_back(p);
+
+			ready.clear();
+			order.clear();
+		}
+	}
+
+	for (auto &p : packets)
+		*out << p;
+}
+
+} // namespace av
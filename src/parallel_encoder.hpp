@@ -0,0 +1,69 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include "queue.hpp"
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace av
+{
+
+/*
+ * Encoder for intra-only codecs (mjpeg, ffv1, prores_ks...) spreading the
+ * frames round-robin over several instances of the codec, each on its own
+ * thread. The packets are written to the output in the order the frames
+ * were pushed, which must be increasing pts. Frames are shared by
+ * reference with the worker threads.
+ */
+class parallel_encoder
+{
+public:
+	parallel_encoder(size_t queue_size = 2)
+	    : out(nullptr), queue_size(queue_size), next(0), failed(false)
+	{
+	}
+	~parallel_encoder() { flush(); }
+
+	bool open(output &out, const std::string &codec,
+		  const std::string &options = "", size_t nb_instances = 0);
+
+	bool operator<<(const frame &f);
+	bool flush();
+
+	frame get_empty_frame();
+	size_t size() const { return instances.size(); }
+
+private:
+	parallel_encoder(const parallel_encoder &) = delete;
+	parallel_encoder &operator=(const parallel_encoder &) = delete;
+
+	struct instance {
+		instance(encoder &&enc, size_t queue_size)
+		    : enc(std::move(enc)), queue(queue_size)
+		{
+		}
+
+		encoder enc;
+		bounded_queue<frame> queue;
+		std::thread worker;
+	};
+
+	void run(instance &i);
+	void receive(instance &i);
+	void write_ready(bool all);
+
+	output *out;
+	size_t queue_size, next;
+	std::vector<std::unique_ptr<instance>> instances;
+
+	std::mutex m;
+	std::deque<int64_t> order;
+	std::map<int64_t, std::vector<packet>> ready;
+	std::atomic<bool> failed;
+};
+
+} // namespace av
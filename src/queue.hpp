@@ -0,0 +1,107 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace av
+{
+
+/*
+ * Bounded blocking FIFO shared between a producer and a worker thread.
+ * push() blocks while the queue is full, pop() blocks while it is empty.
+ * Once closed, push() fails and pop() drains what is left then fails.
+ */
+template <typename T> class bounded_queue
+{
+public:
+	bounded_queue(size_t capacity) : capacity(capacity), closed(false) {}
+
+	bool push(const T &item)
+	{
+		std::unique_lock<std::mutex> l(m);
+
+		while (items.size() >= capacity && !closed)
+			not_full.wait(l);
+
+		if (closed)
+			return false;
+
+		items.push_back(item);
+		l.unlock();
+
+		not_empty.notify_one();
+		return true;
+	}
+
+	bool try_push(const T &item)
+	{
+		{
+			std::lock_guard<std::mutex> l(m);
+
+			if (closed || items.size() >= capacity)
+				return false;
+
+			items.push_back(item);
+		}
+		not_empty.notify_one();
+		return true;
+	}
+
+	bool pop(T &item)
+	{
+		std::unique_lock<std::mutex> l(m);
+
+		while (items.empty() && !closed)
+			not_empty.wait(l);
+
+		if (items.empty())
+			return false;
+
+		item = std::move(items.front());
+		items.pop_front();
+		l.unlock();
+
+		not_full.notify_one();
+		return true;
+	}
+
+	void close(bool immediately = false)
+	{
+		{
+			std::lock_guard<std::mutex> l(m);
+
+			closed = true;
+
+			if (immediately)
+				items.clear();
+		}
+		not_empty.notify_all();
+		not_full.notify_all();
+	}
+
+	size_t size()
+	{
+		std::lock_guard<std::mutex> l(m);
+
+		return items.size();
+	}
+
+	bool is_closed()
+	{
+		std::lock_guard<std::mutex> l(m);
+
+		return closed;
+	}
+
+private:
+	bounded_queue(const bounded_queue &) = delete;
+	bounded_queue &operator=(const bounded_queue &) = delete;
+
+	size_t capacity;
+	bool closed;
+	std::mutex m;
+	std::condition_variable not_empty, not_full;
+	std::deque<T> items;
+};
+
+} // namespace av
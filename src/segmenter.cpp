@@ -0,0 +1,163 @@
+#include "segmenter.hpp"
+#include <cstdio>
+
+namespace av
+{
+
+bool segmenter::open(const std::string &pattern, double duration,
+		     const std::string &format, const std::string &options,
+		     bool preopen)
+{
+	close();
+
+	this->pattern = pattern;
+	this->format = format;
+	this->options = options;
+	this->duration = duration;
+	this->preopen = preopen;
+
+	if ((format == "mp4" || format == "mov") && options.empty())
+		this->options = "movflags=+frag_keyframe+empty_moov+"
+				"default_base_moof";
+
+	index = 0;
+	reference = -1;
+	segment_start = AV_NOPTS_VALUE;
+
+	current = open_segment(index);
+	if (!current)
+		return false;
+
+	if (preopen)
+		next = std::async(std::launch::async,
+				  &segmenter::open_segment, this, index + 1);
+	return true;
+}
+
+std::string segmenter::segment_uri(int index) const
+{
+	return fmt::format(fmt::runtime(pattern), index);
+}
+
+std::unique_ptr<output> segmenter::open_segment(int index)
+{
+	auto out = std::make_unique<output>();
+	std::string uri = segment_uri(index);
+
+	if (!out->open_format(uri, format, options)) {
+		fmt::print(stderr, "Cannot open segment '{}'\n", uri);
+		return nullptr;
+	}
+	return out;
+}
+
+void segmenter::set_reference(int stream_index)
+{
+	AVStream *stream = current->ctx->streams[stream_index];
+
+	if (reference < 0 &&
+	    stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+		reference = stream_index;
+}
+
+encoder segmenter::add_stream(const std::string &codec,
+			      const std::string &options)
+{
+	encoder enc = current->add_stream(codec, options);
+
+	if (!!enc)
+		set_reference(enc.stream_index);
+	return enc;
+}
+
+int segmenter::add_stream(const input &in, int index)
+{
+	int ret = current->add_stream(in, index);
+
+	if (ret >= 0)
+		set_reference(ret);
+	return ret;
+}
+
+bool segmenter::rotate()
+{
+	std::unique_ptr<output> out;
+
+	if (preopen)
+		out = next.get();
+	else
+		out = open_segment(index + 1);
+
+	for (unsigned int i = 0; out && i < current->ctx->nb_streams; i++)
+		if (out->add_stream(*current, i) < 0)
+			out.reset();
+
+	/*
+	 * the current segment goes on and the next keyframe tries again:
+	 * the pre-opened segment is needed for that
+	 */
+	if (!out) {
+		std::remove(segment_uri(index + 1).c_str());
+
+		if (preopen)
+			next = std::async(std::launch::async,
+					  &segmenter::open_segment, this,
+					  index + 1);
+		return false;
+	}
+
+	index++;
+
+	if (preopen)
+		next = std::async(std::launch::async,
+				  &segmenter::open_segment, this, index + 1);
+
+	// the trailer of the previous segment is written in background
+	if (finalizer.valid())
+		finalizer.wait();
+
+	auto finalize = [old = std::move(current)]() mutable { old.reset(); };
+
+	finalizer = std::async(std::launch::async, std::move(finalize));
+
+	current = std::move(out);
+	return true;
+}
+
+bool segmenter::operator<<(const packet &p)
+{
+	if (!current)
+		return false;
+
+	if (p.stream_index() == reference && p.is_keyframe() &&
+	    p.pts() != AV_NOPTS_VALUE) {
+		AVRational tb = current->time_base(reference);
+
+		if (segment_start == AV_NOPTS_VALUE)
+			segment_start = p.pts();
+		else if ((p.pts() - segment_start) * av_q2d(tb) >= duration) {
+			if (!rotate())
+				return false;
+
+			segment_start = p.pts();
+		}
+	}
+
+	return *current << p;
+}
+
+void segmenter::close()
+{
+	if (finalizer.valid())
+		finalizer.wait();
+
+	current.reset();
+
+	if (next.valid()) {
+		// drop the pre-opened segment that was never written
+		if (next.get())
+			std::remove(segment_uri(index + 1).c_str());
+	}
+}
+
+} // namespace av
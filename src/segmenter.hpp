@@ -0,0 +1,56 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <future>
+#include <memory>
+#include <string>
+
+namespace av
+{
+
+/*
+ * Rolling output split in segments of about `duration` seconds. Segments
+ * are cut on keyframes of the first video stream; only the muxer and its
+ * AVIO are rotated, the encoders returned by add_stream() are kept open.
+ * The segment file name is built from a fmt pattern with the segment
+ * index, e.g. "/tmp/record-{:05d}.ts".
+ */
+class segmenter
+{
+public:
+	segmenter() : duration(0), preopen(false), index(0), reference(-1) {}
+	~segmenter() { close(); }
+
+	bool open(const std::string &pattern, double duration,
+		  const std::string &format = "",
+		  const std::string &options = "", bool preopen = true);
+
+	encoder add_stream(const std::string &codec,
+			   const std::string &options = "");
+	int add_stream(const input &in, int index);
+
+	bool operator<<(const packet &p);
+
+	int segment() const { return index; }
+
+private:
+	segmenter(const segmenter &) = delete;
+	segmenter &operator=(const segmenter &) = delete;
+
+	std::string segment_uri(int index) const;
+	std::unique_ptr<output> open_segment(int index);
+	void set_reference(int stream_index);
+	bool rotate();
+	void close();
+
+	std::string pattern, format, options;
+	double duration;
+	bool preopen;
+	int index, reference;
+	int64_t segment_start;
+
+	std::unique_ptr<output> current;
+	std::future<std::unique_ptr<output>> next;
+	std::future<void> finalizer;
+};
+
+} // namespace av
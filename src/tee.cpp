@@ -0,0 +1,97 @@
+#include "tee.hpp"
+
+namespace av
+{
+
+void tee::destination::run()
+{
+	packet p;
+
+	while (queue.pop(p)) {
+		if (!(out << p)) {
+			fmt::print(stderr, "tee: write fails, disconnecting\n");
+			disconnect();
+			break;
+		}
+	}
+}
+
+void tee::destination::disconnect()
+{
+	connected = false;
+	queue.close(true);
+}
+
+int tee::add_destination(output &out, tee_policy policy, size_t queue_size)
+{
+	destinations.push_back(
+	    std::make_unique<destination>(out, policy, queue_size));
+
+	destination *d = destinations.back().get();
+	d->worker = std::thread(&destination::run, d);
+
+	return destinations.size() - 1;
+}
+
+bool tee::operator<<(const packet &p)
+{
+	unsigned int index = p.stream_index();
+	bool ret = false;
+
+	for (auto &d : destinations) {
+		if (!d->connected)
+			continue;
+
+		ret = true;
+
+		if (d->waiting_keyframe.size() <= index)
+			d->waiting_keyframe.resize(index + 1);
+
+		if (d->waiting_keyframe[index]) {
+			if (!p.is_keyframe()) {
+				d->dropped++;
+				continue;
+			}
+			d->waiting_keyframe[index] = false;
+		}
+
+		if (d->queue.try_push(p))
+			continue;
+
+		d->dropped++;
+
+		if (d->policy == tee_policy::disconnect) {
+			fmt::print(stderr, "tee: destination too slow, "
+					   "disconnecting\n");
+			d->disconnect();
+			continue;
+		}
+
+		// every stream restarts on its own keyframe
+		d->waiting_keyframe.assign(d->waiting_keyframe.size(), true);
+	}
+
+	return ret;
+}
+
+void tee::close()
+{
+	for (auto &d : destinations)
+		d->queue.close();
+
+	for (auto &d : destinations)
+		if (d->worker.joinable())
+			d->worker.join();
+}
+
+bool tee::connected(int index) const
+{
+	return destinations.at(index)->connected;
+}
+
+uint64_t tee::dropped(int index) const
+{
+	return destinations.at(index)->dropped;
+}
+
+} // namespace av
@@ -0,0 +1,68 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include "queue.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace av
+{
+
+/*
+ * What a destination of a tee does when it can't keep up and its queue is
+ * full: skip packets until the next keyframe of each stream, or stop
+ * receiving anything.
+ */
+enum class tee_policy { drop, disconnect };
+
+/*
+ * Encoded packets shared by reference with several outputs, each written
+ * by its own thread from its own bounded queue, so that a slow destination
+ * (network, pipe) never stalls the others nor the producer: pushing never
+ * blocks. The streams of every output must match the packets stream
+ * indexes, like for output::add_stream(input, index).
+ */
+class tee
+{
+public:
+	tee() {}
+	~tee() { close(); }
+
+	int add_destination(output &out, tee_policy policy,
+			    size_t queue_size = 64);
+
+	bool operator<<(const packet &p);
+	void close();
+
+	size_t size() const { return destinations.size(); }
+	bool connected(int index) const;
+	uint64_t dropped(int index) const;
+
+private:
+	tee(const tee &) = delete;
+	tee &operator=(const tee &) = delete;
+
+	struct destination {
+		destination(output &out, tee_policy policy, size_t queue_size)
+		    : out(out), policy(policy), queue(queue_size),
+		      connected(true), dropped(0)
+		{
+		}
+
+		void run();
+		void disconnect();
+
+		output &out;
+		tee_policy policy;
+		bounded_queue<packet> queue;
+		std::thread worker;
+		std::atomic<bool> connected;
+		std::atomic<uint64_t> dropped;
+		std::vector<bool> waiting_keyframe;
+	};
+
+	std::vector<std::unique_ptr<destination>> destinations;
+};
+
+} // namespace av
@@ -0,0 +1,135 @@
+#include "thread_pool.hpp"
+
+namespace av
+{
+
+static thread_local const thread_pool *current_pool = nullptr;
+static thread_local int current_index = -1;
+
+thread_pool::thread_pool(size_t nb_workers)
+    : queued(0), round_robin(0), stopping(false)
+{
+	if (nb_workers == 0)
+		nb_workers = std::max(1u, std::thread::hardware_concurrency());
+
+	for (size_t i = 0; i < nb_workers; i++)
+		workers.push_back(std::make_unique<worker>());
+
+	for (size_t i = 0; i < nb_workers; i++)
+		workers[i]->thread = std::thread(&thread_pool::run, this, i);
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> l(m);
+		stopping = true;
+	}
+	cv.notify_all();
+
+	for (auto &w : workers)
+		w->thread.join();
+}
+
+thread_pool &thread_pool::shared()
+{
+	static thread_pool pool;
+
+	return pool;
+}
+
+void thread_pool::submit(std::function<void()> task)
+{
+	int index = worker_index();
+	worker *w;
+
+	if (index < 0)
+		index = round_robin++ % workers.size();
+	w = workers[index].get();
+
+	{
+		std::lock_guard<std::mutex> l(w->m);
+		w->tasks.push_back(std::move(task));
+		queued++;
+	}
+
+	// a worker checking queued holds m until it sleeps
+	{
+		std::lock_guard<std::mutex> l(m);
+	}
+	cv.notify_one();
+}
+
+bool thread_pool::run_one()
+{
+	std::function<void()> task;
+	int index = worker_index();
+
+	if (!next(index < 0 ? 0 : index, task))
+		return false;
+
+	task();
+	return true;
+}
+
+int thread_pool::worker_index() const
+{
+	return current_pool == this ? current_index : -1;
+}
+
+void thread_pool::run(size_t index)
+{
+	std::function<void()> task;
+
+	current_pool = this;
+	current_index = index;
+
+	for (;;) {
+		if (next(index, task)) {
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> l(m);
+
+		cv.wait(l, [&]() { return queued > 0 || stopping; });
+
+		if (stopping && queued == 0)
+			break;
+	}
+}
+
+bool thread_pool::next(size_t index, std::function<void()> &task)
+{
+	size_t n = workers.size();
+
+	// own tasks newest first, they are the most likely to be cache hot
+	{
+		worker *w = workers[index].get();
+		std::lock_guard<std::mutex> l(w->m);
+
+		if (!w->tasks.empty()) {
+			task = std::move(w->tasks.back());
+			w->tasks.pop_back();
+			queued--;
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i < n; i++) {
+		worker *w = workers[(index + i) % n].get();
+		std::lock_guard<std::mutex> l(w->m);
+
+		if (!w->tasks.empty()) {
+			task = std::move(w->tasks.front());
+			w->tasks.pop_front();
+			queued--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+} // namespace av
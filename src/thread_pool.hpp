@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace av
+{
+
+/*
+ * Fixed set of worker threads, one per core by default. Each worker runs
+ * the tasks of its own deque newest first and steals the oldest task of
+ * another worker when it has none. Tasks submitted from a worker go to its
+ * own deque, the others are spread round-robin. The destructor runs the
+ * queued tasks to completion. run_one() lets a thread waiting on tasks
+ * help instead of blocking, which also keeps a worker waiting on its own
+ * subtasks from deadlocking.
+ */
+class thread_pool
+{
+public:
+	explicit thread_pool(size_t nb_workers = 0);
+	~thread_pool();
+
+	static thread_pool &shared();
+
+	void submit(std::function<void()> task);
+	bool run_one();
+
+	size_t size() const { return workers.size(); }
+	int worker_index() const;
+
+private:
+	thread_pool(const thread_pool &) = delete;
+	thread_pool &operator=(const thread_pool &) = delete;
+
+	struct worker {
+		std::mutex m;
+		std::deque<std::function<void()>> tasks;
+		std::thread thread;
+	};
+
+	void run(size_t index);
+	bool next(size_t index, std::function<void()> &task);
+
+	std::vector<std::unique_ptr<worker>> workers;
+
+	std::mutex m;
+	std::condition_variable cv;
+	std::atomic<size_t> queued;
+	std::atomic<size_t> round_robin;
+	bool stopping;
+};
+
+} // namespace av
@@ -0,0 +1,185 @@
+#include "thumbnailer.hpp"
+#include <thread>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+namespace av
+{
+
+/*
+ * evenly spaced, in the middle of count equal parts of the stream
+ */
+std::vector<thumbnail> thumbnailer::extract(const std::string &uri,
+					    int count)
+{
+	std::vector<double> times;
+	double duration;
+	input in;
+	int index;
+
+	if (!in.open(uri))
+		return {};
+
+	index = in.get_video_index();
+	if (index < 0) {
+		fmt::print(stderr, "{}: no video stream\n", uri);
+		return {};
+	}
+
+	duration = in.duration(index) * av_q2d(in.time_base(index));
+
+	for (int i = 0; i < count; i++)
+		times.push_back((i + 0.5) * duration / count);
+
+	return extract(uri, times);
+}
+
+std::vector<thumbnail> thumbnailer::extract(const std::string &uri,
+					    const std::vector<double> &times)
+{
+	std::vector<thumbnail> thumbnails(times.size());
+	std::vector<std::thread> workers;
+	std::atomic<size_t> next(0);
+	size_t n = nb_workers;
+
+	for (size_t i = 0; i < times.size(); i++)
+		thumbnails[i].time = times[i];
+
+	if (n == 0)
+		n = std::max(1u, std::thread::hardware_concurrency());
+	n = std::min(n, times.size());
+
+	for (size_t i = 0; i < n; i++)
+		workers.emplace_back(&thumbnailer::run, this, std::cref(uri),
+				     std::ref(thumbnails), std::ref(next));
+
+	for (auto &w : workers)
+		w.join();
+
+	return thumbnails;
+}
+
+void thumbnailer::run(const std::string &uri,
+		      std::vector<thumbnail> &thumbnails,
+		      std::atomic<size_t> &next)
+{
+	state s;
+	frame f;
+
+	if (!open(s, uri))
+		return;
+
+	for (size_t i = next++; i < thumbnails.size(); i = next++) {
+		if (decode(s, thumbnails[i].time, f))
+			encode(s, f, thumbnails[i]);
+	}
+}
+
+bool thumbnailer::open(state &s, const std::string &uri)
+{
+	if (!s.in.open(uri))
+		return false;
+
+	s.index = s.in.get_video_index();
+	if (s.index < 0)
+		return false;
+
+	// the workers already use the cores, frame threads only add delay
+	s.dec = s.in.get(s.index, "", "threads=1");
+	if (!s.dec)
+		return false;
+
+	s.packet = av_packet_alloc();
+	return s.packet != nullptr;
+}
+
+bool thumbnailer::decode(state &s, double time, frame &f)
+{
+	AVRational tb = s.in.time_base(s.index);
+	int64_t target = s.in.start_time(s.index) + time / av_q2d(tb);
+	frame last;
+	packet p;
+
+	if (!s.in.seek(s.index, target))
+		return false;
+
+	s.dec.reset();
+
+	auto reached = [&]() {
+		while (s.dec >> f) {
+			if (!exact || f.f->best_effort_timestamp >= target)
+				return true;
+			last = f;
+		}
+		return false;
+	};
+
+	while (s.in >> p) {
+		if (p.stream_index() != s.index)
+			continue;
+
+		// skip corrupted packets, the next keyframe will do
+		if (!(s.dec << p))
+			continue;
+
+		if (reached())
+			return true;
+	}
+
+	s.dec.flush();
+	if (reached())
+		return true;
+
+	// past the last frame, use it
+	if (!last.f->buf[0])
+		return false;
+
+	f = last;
+	return true;
+}
+
+bool thumbnailer::encode(state &s, const frame &f, thumbnail &t)
+{
+	if (!s.enc) {
+		const AVCodec *c = avcodec_find_encoder_by_name(codec.c_str());
+		AVPixelFormat format;
+		int w, h;
+
+		if (!c || !c->pix_fmts) {
+			fmt::print(stderr, "{} is not an image encoder\n",
+				   codec);
+			return false;
+		}
+
+		format = c->pix_fmts[0];
+		w = std::min(width, f.f->width) & ~1;
+		h = av_rescale(w, f.f->height, f.f->width) & ~1;
+
+		s.scaler = std::make_unique<frame::scaler>(format, w, h);
+		s.enc = encoder::open(
+		    codec,
+		    fmt::format("video_size={}x{}:pixel_format={}:"
+				"time_base=1/25",
+				w, h, av_get_pix_fmt_name(format)),
+		    false);
+		if (!s.enc)
+			return false;
+	}
+
+	frame scaled = s.scaler->scale(f);
+
+	scaled.f->pts = 0;
+
+	// image encoders have no delay, one frame in, one packet out
+	if (!s.enc.send(scaled.f) || !s.enc.receive(s.packet))
+		return false;
+
+	t.data.assign(s.packet->data, s.packet->data + s.packet->size);
+	av_packet_unref(s.packet);
+
+	return true;
+}
+
+} // namespace av
@@ -0,0 +1,75 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace av
+{
+
+/*
+ * Still image of a video at a given time (seconds from the start of the
+ * stream), encoded in memory. data is empty when nothing could be decoded
+ * there.
+ */
+struct thumbnail {
+	double time;
+	std::vector<uint8_t> data;
+};
+
+/*
+ * Thumbnails of the first video stream of a file. Each target is reached
+ * by seeking to the keyframe before it and decoding from there, instead of
+ * decoding the whole file. The targets are spread over workers, each with
+ * its own input, decoder and image encoder. Frames are downscaled to the
+ * given width keeping the aspect ratio, codec is an image encoder like
+ * mjpeg, png or libwebp.
+ */
+class thumbnailer
+{
+public:
+	thumbnailer(int width = 320, const std::string &codec = "mjpeg",
+		    size_t nb_workers = 0)
+	    : width(width), codec(codec), nb_workers(nb_workers), exact(true)
+	{
+	}
+
+	/*
+	 * exact decodes up to the target, otherwise the keyframe before it is
+	 * used: faster, less accurate on long GOPs
+	 */
+	void set_exact(bool exact) { this->exact = exact; }
+
+	std::vector<thumbnail> extract(const std::string &uri, int count);
+	std::vector<thumbnail> extract(const std::string &uri,
+				       const std::vector<double> &times);
+
+private:
+	thumbnailer(const thumbnailer &) = delete;
+	thumbnailer &operator=(const thumbnailer &) = delete;
+
+	struct state {
+		state() : index(-1), packet(nullptr) {}
+		~state() { av_packet_free(&packet); }
+
+		input in;
+		decoder dec;
+		encoder enc;
+		std::unique_ptr<frame::scaler> scaler;
+		int index;
+		AVPacket *packet;
+	};
+
+	bool open(state &s, const std::string &uri);
+	bool decode(state &s, double time, frame &f);
+	bool encode(state &s, const frame &f, thumbnail &t);
+	void run(const std::string &uri, std::vector<thumbnail> &thumbnails,
+		 std::atomic<size_t> &next);
+
+	int width;
+	std::string codec;
+	size_t nb_workers;
+	bool exact;
+};
+
+} // namespace av
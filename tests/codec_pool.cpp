@@ -0,0 +1,135 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "codec_pool.hpp"
+#include "common.hpp"
+
+#define NB_FRAMES 30
+
+static const std::string clip_a = "/tmp/codec_pool_a.mkv";
+static const std::string clip_b = "/tmp/codec_pool_b.mkv";
+static const std::string clip_c = "/tmp/codec_pool_c.mkv";
+
+/*
+ * decode the first stream of an input, one checksum of the luma plane per
+ * frame
+ */
+static std::vector<uint64_t> decode(av::input &in, av::decoder &dec)
+{
+	std::vector<uint64_t> sums;
+	av::packet p;
+	av::frame f;
+
+	auto drain = [&]() {
+		while (dec >> f) {
+			uint64_t sum = 0;
+
+			for (int y = 0; y < f.f->height; y++) {
+				uint8_t *row =
+				    f.f->data[0] + y * f.f->linesize[0];
+
+				for (int x = 0; x < f.f->width; x++)
+					sum += row[x];
+			}
+			sums.push_back(sum);
+		}
+	};
+
+	while (in >> p) {
+		if (p.stream_index() != 0)
+			continue;
+
+		dec << p;
+		drain();
+	}
+
+	dec.flush();
+	drain();
+
+	return sums;
+}
+
+TEST_CASE("Pooled decoders are reused and reset", "[codec_pool]")
+{
+	REQUIRE(generate_clip(clip_a, "libx264", 320, 240, NB_FRAMES));
+	REQUIRE(generate_clip(clip_b, "libx264", 320, 240, NB_FRAMES));
+	REQUIRE(generate_clip(clip_c, "libx264", 640, 480, NB_FRAMES));
+
+	av::codec_pool pool(1);
+	av::input in;
+
+	REQUIRE(in.open(clip_a));
+	av::decoder dec = pool.get(in, 0);
+	REQUIRE(!!dec);
+	REQUIRE(decode(in, dec).size() == NB_FRAMES);
+	pool.release(std::move(dec));
+
+	REQUIRE(pool.idle() == 1);
+	REQUIRE(pool.misses() == 1);
+
+	SECTION("same parameters")
+	{
+		av::input fresh_in;
+
+		REQUIRE(fresh_in.open(clip_b));
+		av::decoder fresh = fresh_in.get(0);
+		auto expected = decode(fresh_in, fresh);
+
+		REQUIRE(in.open(clip_b));
+		dec = pool.get(in, 0);
+		REQUIRE(!!dec);
+		REQUIRE(pool.hits() == 1);
+		REQUIRE(pool.idle() == 0);
+
+		// a flushed decoder gives the same frames as a new one
+		REQUIRE(decode(in, dec) == expected);
+	}
+
+	SECTION("other parameters")
+	{
+		REQUIRE(in.open(clip_c));
+		dec = pool.get(in, 0);
+		REQUIRE(!!dec);
+		REQUIRE(pool.hits() == 0);
+		REQUIRE(decode(in, dec).size() == NB_FRAMES);
+
+		// only one context is kept idle
+		pool.release(std::move(dec));
+		REQUIRE(pool.idle() == 1);
+	}
+
+	SECTION("frames skipped by the previous user")
+	{
+		REQUIRE(in.open(clip_b));
+		dec = pool.get(in, 0);
+		REQUIRE(pool.hits() == 1);
+
+		// left by a load shedder: keyframes only
+		dec.discard(AVDISCARD_NONKEY);
+		pool.release(std::move(dec));
+
+		REQUIRE(in.open(clip_b));
+		dec = pool.get(in, 0);
+		REQUIRE(pool.hits() == 2);
+		REQUIRE(decode(in, dec).size() == NB_FRAMES);
+	}
+
+	SECTION("dropped without release")
+	{
+		REQUIRE(in.open(clip_b));
+		dec = pool.get(in, 0);
+		REQUIRE(pool.hits() == 1);
+
+		// the context and its entry go away with the wrapper
+		dec = av::decoder();
+		REQUIRE(pool.idle() == 0);
+
+		REQUIRE(in.open(clip_c));
+		dec = pool.get(in, 0);
+		REQUIRE(!!dec);
+		REQUIRE(pool.hits() == 1);
+		REQUIRE(decode(in, dec).size() == NB_FRAMES);
+
+		pool.release(std::move(dec));
+		REQUIRE(pool.idle() == 1);
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "ffmpeg.hpp"
+#include "frame_view.hpp"
+#include <string>
+
+/*
+ * code borrow from ffmpeg documentation/example
+ */
+inline void generate_frame(AVFrame *f, int index, int width, int height)
+{
+	if (!av_frame_is_writable(f)) {
+		f->width = width;
+		f->height = height;
+		f->format = AV_PIX_FMT_YUV420P;
+		av_frame_get_buffer(f, 0);
+	}
+
+	av_frame_make_writable(f);
+
+	av::frame_view<AV_PIX_FMT_YUV420P> v(f);
+	if (!v)
+		return;
+
+	/* Y */
+	for (int y = 0; y < height; y++) {
+		auto row = v.row<0>(y);
+
+		for (int x = 0; x < width; x++)
+			row[x] = x + y + index * 3;
+	}
+
+	/* Cb and Cr */
+	for (int y = 0; y < height / 2; y++) {
+		auto cb = v.row<1>(y);
+		auto cr = v.row<2>(y);
+
+		for (int x = 0; x < width / 2; x++) {
+			cb[x] = 128 + y + index * 2;
+			cr[x] = 64 + x + index * 5;
+		}
+	}
+
+	f->pts = index;
+}
+
+/*
+ * encode nb_frames synthetic frames at 25 fps into uri
+ */
+inline bool generate_clip(const std::string &uri, const std::string &codec,
+			  int width, int height, int nb_frames,
+			  const std::string &options = "")
+{
+	av::output out;
+	av::encoder enc;
+	av::frame f;
+	av::packet p;
+	std::string opts;
+
+	if (!out.open(uri))
+		return false;
+
+	opts = fmt::format("video_size={}x{}:pixel_format=yuv420p:"
+			   "time_base=1/25",
+			   width, height);
+	if (!options.empty())
+		opts += ":" + options;
+
+	enc = out.add_stream(codec, opts);
+	if (!enc)
+		return false;
+
+	f = enc.get_empty_frame();
+
+	for (int i = 0; i < nb_frames; i++) {
+		generate_frame(f.f, i, width, height);
+
+		if (!(enc << f))
+			return false;
+
+		while (enc >> p)
+			out << p;
+	}
+
+	enc.flush();
+	while (enc >> p)
+		out << p;
+
+	return true;
+}
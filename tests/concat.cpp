@@ -0,0 +1,159 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "concat.hpp"
+
+#define NB_FRAMES 50
+
+static const std::string joined = "/tmp/concat_out.ts";
+
+struct joined_stats {
+	int packets;
+	int frames;
+	int width;
+	bool monotonic;
+};
+
+static joined_stats read_joined()
+{
+	joined_stats stats = {0, 0, 0, true};
+	int64_t last_dts = AV_NOPTS_VALUE;
+	av::input in;
+	av::packet p;
+	av::frame f;
+
+	if (!in.open(joined))
+		return stats;
+
+	av::decoder dec = in.get(0);
+	if (!dec)
+		return stats;
+
+	auto count = [&]() {
+		while (dec >> f) {
+			stats.frames++;
+			stats.width = f.f->width;
+		}
+	};
+
+	while (in >> p) {
+		if (last_dts != AV_NOPTS_VALUE && p.dts() <= last_dts)
+			stats.monotonic = false;
+		last_dts = p.dts();
+		stats.packets++;
+
+		dec << p;
+		count();
+	}
+
+	dec.flush();
+	count();
+
+	return stats;
+}
+
+TEST_CASE("Concatenation of compatible inputs", "[concat]")
+{
+	std::vector<std::string> uris;
+
+	for (int i = 0; i < 3; i++) {
+		uris.push_back(fmt::format("/tmp/concat_in_{}.mkv", i));
+		REQUIRE(generate_clip(uris.back(), "libx264", 320, 240,
+				      NB_FRAMES, "g=25:bf=2"));
+	}
+
+	{
+		av::output out;
+		av::concat_stats stats;
+
+		REQUIRE(out.open(joined));
+		REQUIRE(av::concat(uris, out, "", &stats));
+
+		REQUIRE(stats.packets == 3 * NB_FRAMES);
+		REQUIRE(stats.reencoded == 0);
+	}
+
+	auto stats = read_joined();
+
+	REQUIRE(stats.packets == 3 * NB_FRAMES);
+	REQUIRE(stats.frames == 3 * NB_FRAMES);
+	REQUIRE(stats.monotonic);
+}
+
+/*
+ * the last input has another size: only it is re-encoded, to the size of
+ * the first one
+ */
+TEST_CASE("Concatenation with an incompatible input", "[concat]")
+{
+	std::vector<std::string> uris;
+
+	for (int i = 0; i < 3; i++) {
+		int width = i < 2 ? 320 : 160, height = i < 2 ? 240 : 120;
+
+		uris.push_back(fmt::format("/tmp/concat_in_{}.mkv", i));
+		REQUIRE(generate_clip(uris.back(), "libx264", width, height,
+				      NB_FRAMES, "g=25:bf=2"));
+	}
+
+	{
+		av::output out;
+		av::concat_stats stats;
+
+		REQUIRE(out.open(joined));
+		REQUIRE(av::concat(uris, out, "bf=0", &stats));
+
+		REQUIRE(stats.packets == 3 * NB_FRAMES);
+		REQUIRE(stats.reencoded == NB_FRAMES);
+	}
+
+	auto stats = read_joined();
+
+	REQUIRE(stats.frames == 3 * NB_FRAMES);
+	REQUIRE(stats.width == 320);
+	REQUIRE(stats.monotonic);
+}
+
+/*
+ * mpegts has no header: the inputs opened ahead in background rely on the
+ * stream infos of the scan, the re-encoded one is decoded with them
+ */
+TEST_CASE("Concatenation of mpegts inputs", "[concat]")
+{
+	std::vector<std::string> uris;
+	int small = -1;
+	uint64_t reencoded = 0;
+
+	SECTION("compatible") {}
+	SECTION("incompatible")
+	{
+		small = 2;
+		reencoded = NB_FRAMES;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		int width = i == small ? 160 : 320;
+		int height = i == small ? 120 : 240;
+
+		uris.push_back(fmt::format("/tmp/concat_in_{}.ts", i));
+		REQUIRE(generate_clip(uris.back(), "libx264", width, height,
+				      NB_FRAMES, "g=25:bf=2"));
+	}
+
+	{
+		av::output out;
+		av::concat_stats stats;
+
+		REQUIRE(out.open(joined));
+		REQUIRE(av::concat(uris, out, "bf=0", &stats));
+
+		REQUIRE(stats.packets == 3 * NB_FRAMES);
+		REQUIRE(stats.reencoded == reencoded);
+	}
+
+	auto stats = read_joined();
+
+	REQUIRE(stats.frames == 3 * NB_FRAMES);
+	REQUIRE(stats.width == 320);
+	REQUIRE(stats.monotonic);
+}
@@ -0,0 +1,157 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "edit.hpp"
+#include "hash.hpp"
+
+#define NB_FRAMES 250
+#define FPS 25
+
+static const std::string clip = "/tmp/smart_cut_in.mkv";
+static const std::string cut = "/tmp/smart_cut_out.ts";
+
+static std::vector<uint64_t> decode_hashes(const std::string &uri)
+{
+	std::vector<uint64_t> hashes;
+	av::input in;
+	av::packet p;
+	av::frame f;
+
+	if (!in.open(uri))
+		return hashes;
+
+	av::decoder dec = in.get(0);
+	if (!dec)
+		return hashes;
+
+	while (in >> p) {
+		dec << p;
+		while (dec >> f)
+			hashes.push_back(av::hash(f).all);
+	}
+
+	dec.flush();
+	while (dec >> f)
+		hashes.push_back(av::hash(f).all);
+
+	return hashes;
+}
+
+/*
+ * Frames first to last - 1 of the clip, keyframes every 25 frames. The
+ * boundary GOPs are re-encoded losslessly so that every frame of the cut
+ * decodes to the original one.
+ */
+TEST_CASE("Smart cut is frame accurate", "[edit]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:bf=2:x264-params=scenecut=0"));
+
+	auto original = decode_hashes(clip);
+	REQUIRE(original.size() == NB_FRAMES);
+
+	int first = 0, last = 0;
+	uint64_t min_copied = 0, max_encoded = 0;
+
+	SECTION("boundaries inside GOPs")
+	{
+		first = 38;
+		last = 183;
+		min_copied = 100;
+		max_encoded = 45;
+	}
+	SECTION("boundaries on keyframes")
+	{
+		first = 50;
+		last = 150;
+		min_copied = 100;
+		max_encoded = 0;
+	}
+	SECTION("inside a single GOP")
+	{
+		first = 30;
+		last = 45;
+		min_copied = 0;
+		max_encoded = 15;
+	}
+	SECTION("up to the end")
+	{
+		first = 210;
+		last = NB_FRAMES;
+		min_copied = 25;
+		max_encoded = 15;
+	}
+
+	{
+		av::input in;
+		av::output out;
+		av::cut_stats stats;
+
+		REQUIRE(in.open(clip));
+		REQUIRE(out.open(cut));
+		REQUIRE(av::smart_cut(in, out, (double)first / FPS,
+				      (double)last / FPS, "libx264", "qp=0",
+				      &stats));
+
+		REQUIRE(stats.copied + stats.encoded == (uint64_t)last - first);
+		REQUIRE(stats.copied >= min_copied);
+		REQUIRE(stats.encoded <= max_encoded);
+	}
+
+	auto hashes = decode_hashes(cut);
+	std::vector<uint64_t> expected(original.begin() + first,
+				       original.begin() + last);
+
+	REQUIRE(hashes.size() == expected.size());
+	for (size_t i = 0; i < hashes.size(); i++)
+		REQUIRE(hashes[i] == expected[i]);
+}
+
+TEST_CASE("Re-encoded GOPs keep the stream properties", "[edit]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:bf=2:aspect=4/3:colorspace=bt709:"
+			      "color_primaries=bt709:color_trc=bt709"));
+
+	{
+		av::input in;
+		av::output out;
+		av::cut_stats stats;
+
+		REQUIRE(in.open(clip));
+		REQUIRE(out.open(cut));
+		REQUIRE(av::smart_cut(in, out, 38.0 / FPS, 183.0 / FPS, "",
+				      "", &stats));
+		REQUIRE(stats.encoded > 0);
+		REQUIRE(stats.copied > 0);
+	}
+
+	av::input in;
+	av::packet p;
+	av::frame f;
+	int nb_frames = 0;
+
+	REQUIRE(in.open(cut));
+	av::decoder dec = in.get(0);
+	REQUIRE(!!dec);
+
+	auto check = [&]() {
+		while (dec >> f) {
+			AVRational sar = f.f->sample_aspect_ratio;
+
+			REQUIRE(av_cmp_q(sar, {4, 3}) == 0);
+			REQUIRE(f.f->colorspace == AVCOL_SPC_BT709);
+			nb_frames++;
+		}
+	};
+
+	while (in >> p) {
+		REQUIRE(dec << p);
+		check();
+	}
+
+	dec.flush();
+	check();
+
+	REQUIRE(nb_frames == 183 - 38);
+}
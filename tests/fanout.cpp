@@ -0,0 +1,107 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "fanout.hpp"
+#include "hash.hpp"
+
+#define NB_FRAMES 50
+
+static const std::string shared = "/tmp/fanout_shared.mkv";
+static const std::string single = "/tmp/fanout_single.mkv";
+
+static std::string options(int width, int height)
+{
+	return fmt::format("video_size={}x{}:pixel_format=yuv420p:"
+			   "time_base=1/25",
+			   width, height);
+}
+
+/*
+ * decodes every stream of uri, check gets the stream index and the frame
+ */
+static void decode(const std::string &uri,
+		   const std::function<void(int, const av::frame &)> &check)
+{
+	std::vector<av::decoder> decoders;
+	av::input in;
+	av::packet p;
+	av::frame f;
+
+	REQUIRE(in.open(uri));
+
+	for (int i = 0; i < in.nb_streams(); i++) {
+		decoders.push_back(in.get(i));
+		REQUIRE(!!decoders.back());
+	}
+
+	while (in >> p) {
+		int i = p.stream_index();
+
+		REQUIRE(decoders[i] << p);
+		while (decoders[i] >> f)
+			check(i, f);
+	}
+
+	for (int i = 0; i < in.nb_streams(); i++) {
+		decoders[i].flush();
+		while (decoders[i] >> f)
+			check(i, f);
+	}
+}
+
+/*
+ * two branches sharing an output and one on its own: every branch encodes
+ * every frame, the full size lossless one decodes to the frames pushed
+ */
+TEST_CASE("Every branch gets every frame", "[fanout]")
+{
+	std::vector<uint64_t> expected;
+
+	{
+		av::output a, b;
+		av::fanout fan;
+
+		REQUIRE(a.open(shared));
+		REQUIRE(b.open(single));
+
+		REQUIRE(fan.add_branch(a.add_stream("ffv1", options(320, 240)),
+				       a));
+		REQUIRE(fan.add_branch(a.add_stream("ffv1", options(160, 120)),
+				       a));
+		REQUIRE(fan.add_branch(b.add_stream("ffv1", options(320, 240)),
+				       b));
+		REQUIRE(fan.size() == 3);
+
+		for (int i = 0; i < NB_FRAMES; i++) {
+			av::frame f;
+
+			generate_frame(f.f, i, 320, 240);
+			expected.push_back(av::hash(f).all);
+			REQUIRE(fan << f);
+		}
+
+		fan.flush();
+	}
+
+	std::vector<int> counts(2, 0);
+	std::vector<int> widths = {320, 160};
+
+	decode(shared, [&](int i, const av::frame &f) {
+		REQUIRE(i < 2);
+		REQUIRE(f.f->width == widths[i]);
+		counts[i]++;
+	});
+
+	REQUIRE(counts[0] == NB_FRAMES);
+	REQUIRE(counts[1] == NB_FRAMES);
+
+	size_t n = 0;
+
+	decode(single, [&](int i, const av::frame &f) {
+		REQUIRE(i == 0);
+		REQUIRE(n < expected.size());
+		REQUIRE(av::hash(f).all == expected[n++]);
+	});
+
+	REQUIRE(n == NB_FRAMES);
+}
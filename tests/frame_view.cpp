@@ -0,0 +1,53 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "frame_view.hpp"
+
+TEST_CASE("Views are checked against the frame", "[frame_view]")
+{
+	av::frame f;
+
+	generate_frame(f.f, 1, 33, 17);
+
+	SECTION("format")
+	{
+		REQUIRE(!!av::frame_view<AV_PIX_FMT_YUV420P>(f));
+		REQUIRE(!av::frame_view<AV_PIX_FMT_NV12>(f));
+		REQUIRE(!av::const_frame_view<AV_PIX_FMT_YUV444P>(f));
+	}
+
+	SECTION("shared frames are read only")
+	{
+		av::frame shared = f;
+
+		REQUIRE(!av::frame_view<AV_PIX_FMT_YUV420P>(f));
+		REQUIRE(!!av::const_frame_view<AV_PIX_FMT_YUV420P>(f));
+	}
+
+	SECTION("planes")
+	{
+		av::const_frame_view<AV_PIX_FMT_YUV420P> v(f);
+
+		// odd sizes round the chroma planes up
+		REQUIRE(v.width(0) == 33);
+		REQUIRE(v.height(0) == 17);
+		REQUIRE(v.width(1) == 17);
+		REQUIRE(v.height(2) == 9);
+		REQUIRE(v.row<0>(0).size() == 33);
+
+		REQUIRE(v.row<0>(2)[5] == 5 + 2 + 3);
+		REQUIRE(v.row(1, 4)[0] == 128 + 4 + 2);
+		REQUIRE(v.row<2>(0)[7] == 64 + 7 + 5);
+	}
+
+	STATIC_REQUIRE(!std::is_constructible_v<av::frame_view<AV_PIX_FMT_NV12>,
+						const av::frame &>);
+	STATIC_REQUIRE(
+	    std::is_constructible_v<av::const_frame_view<AV_PIX_FMT_NV12>,
+				    const av::frame &>);
+	STATIC_REQUIRE(av::frame_view<AV_PIX_FMT_NV12>::nb_planes == 2);
+	STATIC_REQUIRE(av::frame_view<AV_PIX_FMT_NV12>::width(1, 33) == 17);
+	STATIC_REQUIRE(
+	    std::is_same_v<av::frame_view<AV_PIX_FMT_YUV420P10LE>::element,
+			   uint16_t>);
+}
@@ -0,0 +1,95 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "hash.hpp"
+
+TEST_CASE("Frame hashes ignore the linesize padding", "[hash]")
+{
+	av::frame tight, padded;
+
+	generate_frame(tight.f, 7, 320, 240);
+
+	// same picture in rows 64 bytes wider than needed
+	padded.f->width = 384;
+	padded.f->height = 240;
+	padded.f->format = AV_PIX_FMT_YUV420P;
+	REQUIRE(av_frame_get_buffer(padded.f, 0) == 0);
+	padded.f->width = 320;
+	generate_frame(padded.f, 7, 320, 240);
+
+	REQUIRE(padded.f->linesize[0] != tight.f->linesize[0]);
+
+	av::frame_hash a = av::hash(tight);
+	av::frame_hash b = av::hash(padded);
+
+	REQUIRE(a.nb_planes == 3);
+	REQUIRE(a.size == 320 * 240 * 3 / 2);
+	REQUIRE(a.planes == b.planes);
+	REQUIRE(a.all == b.all);
+
+	SECTION("a changed sample changes its plane only")
+	{
+		padded.f->data[2][padded.f->linesize[2] * 119 + 159] ^= 1;
+
+		av::frame_hash c = av::hash(padded);
+
+		REQUIRE(c.planes[0] == a.planes[0]);
+		REQUIRE(c.planes[1] == a.planes[1]);
+		REQUIRE(c.planes[2] != a.planes[2]);
+		REQUIRE(c.all != a.all);
+	}
+
+	SECTION("padding bytes are not hashed")
+	{
+		padded.f->data[0][320] ^= 0xff;
+
+		REQUIRE(av::hash(padded).all == a.all);
+	}
+}
+
+TEST_CASE("Framehash files are checked line by line", "[hash]")
+{
+	const std::string path = "/tmp/hash_test.framehash";
+	std::vector<av::frame> frames(10);
+
+	for (int i = 0; i < 10; i++)
+		generate_frame(frames[i].f, i, 64, 48);
+
+	{
+		av::framehash_writer writer;
+
+		REQUIRE(writer.open(path));
+		for (auto &f : frames)
+			REQUIRE(writer.write(0, f));
+	}
+
+	av::framehash_checker checker;
+	REQUIRE(checker.open(path));
+
+	SECTION("same frames")
+	{
+		for (auto &f : frames)
+			REQUIRE(checker.check(0, f));
+
+		REQUIRE(checker.finish());
+	}
+
+	SECTION("a frame differs")
+	{
+		frames[4].f->data[0][0] ^= 1;
+
+		for (auto &f : frames)
+			checker.check(0, f);
+
+		REQUIRE(checker.mismatches() == 1);
+		REQUIRE(!checker.finish());
+	}
+
+	SECTION("frames missing")
+	{
+		for (int i = 0; i < 5; i++)
+			REQUIRE(checker.check(0, frames[i]));
+
+		REQUIRE(!checker.finish());
+	}
+}
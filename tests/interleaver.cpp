@@ -0,0 +1,83 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "interleaver.hpp"
+#include <thread>
+
+#define NB_FRAMES 100
+#define NB_PRODUCERS 4
+
+static const std::string clip = "/tmp/interleaver_test_in.mkv";
+static const std::string merged = "/tmp/interleaver_test_out.mkv";
+
+/*
+ * each producer replays the intra-only clip on its own output stream, with
+ * a queue much smaller than what it submits: the producers wait for the
+ * writer, which has to merge them in dts order
+ */
+TEST_CASE("Packets of several producers are written in order",
+	  "[interleaver]")
+{
+	std::vector<av::packet> packets;
+
+	REQUIRE(generate_clip(clip, "ffv1", 160, 120, NB_FRAMES));
+
+	{
+		av::input in;
+		av::output out;
+		av::packet p;
+		std::vector<std::thread> producers;
+
+		REQUIRE(in.open(clip));
+		while (in >> p)
+			packets.push_back(p);
+		REQUIRE(packets.size() == NB_FRAMES);
+
+		REQUIRE(out.open(merged));
+		for (int i = 0; i < NB_PRODUCERS; i++)
+			REQUIRE(out.add_stream(in, 0) == i);
+
+		av::interleaver il(out, NB_PRODUCERS, 10 * AV_TIME_BASE, 4);
+
+		REQUIRE(!il.submit(NB_PRODUCERS, packets[0]));
+
+		for (int i = 0; i < NB_PRODUCERS; i++)
+			producers.emplace_back([&, i]() {
+				for (auto &packet : packets) {
+					av::packet p = packet;
+
+					p.stream_index(i);
+					if (!il.submit(i, p))
+						break;
+				}
+				il.finish(i);
+			});
+
+		for (auto &t : producers)
+			t.join();
+
+		il.close();
+
+		REQUIRE(il.written() == NB_PRODUCERS * NB_FRAMES);
+		REQUIRE(il.late() == 0);
+	}
+
+	av::input in;
+	av::packet p;
+	std::vector<int> counts(NB_PRODUCERS);
+	int64_t last = INT64_MIN;
+
+	REQUIRE(in.open(merged));
+
+	while (in >> p) {
+		AVRational tb = in.time_base(p.stream_index());
+		int64_t dts = av_rescale_q(p.dts(), tb, AV_TIME_BASE_Q);
+
+		REQUIRE(dts >= last);
+		last = dts;
+		counts[p.stream_index()]++;
+	}
+
+	for (int count : counts)
+		REQUIRE(count == NB_FRAMES);
+}
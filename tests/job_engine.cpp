@@ -0,0 +1,81 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "job_engine.hpp"
+
+TEST_CASE("Jobs run by priority and can be cancelled", "[job_engine]")
+{
+	av::job_engine engine(1);
+	std::atomic<bool> started(false), release(false);
+	std::vector<int> order;
+
+	// keeps the only worker busy while the other jobs are queued
+	engine.submit([&](av::job_context &) {
+		started = true;
+		while (!release)
+			std::this_thread::yield();
+		return true;
+	});
+
+	while (!started)
+		std::this_thread::yield();
+
+	auto record = [&](int value) {
+		return [&order, value](av::job_context &) {
+			order.push_back(value);
+			return value >= 0;
+		};
+	};
+
+	engine.submit(record(1), 1);
+	engine.submit(record(-1), 5);
+	uint64_t id = engine.submit(record(2), 10);
+	engine.submit(record(3), 1);
+
+	REQUIRE(engine.cancel(id));
+
+	release = true;
+	engine.wait();
+
+	REQUIRE(order == std::vector<int>{-1, 1, 3});
+	REQUIRE(engine.succeeded() == 3);
+	REQUIRE(engine.failed() == 1);
+	REQUIRE(engine.cancelled() == 1);
+	REQUIRE(!engine.cancel(id));
+}
+
+TEST_CASE("Running jobs see their cancellation", "[job_engine]")
+{
+	av::job_engine engine(2);
+	std::atomic<bool> started(false);
+
+	uint64_t id = engine.submit([&](av::job_context &ctx) {
+		started = true;
+		while (!ctx.cancelled())
+			std::this_thread::yield();
+		return false;
+	});
+
+	while (!started)
+		std::this_thread::yield();
+
+	engine.cancel_all();
+	engine.wait();
+
+	REQUIRE(engine.cancelled() == 1);
+	REQUIRE(!engine.cancel(id));
+}
+
+TEST_CASE("Codec threads fit the cores left by the workers", "[job_engine]")
+{
+	av::job_engine engine(1);
+	std::string options;
+
+	engine.submit([&](av::job_context &ctx) {
+		options = ctx.codec_options("g=25");
+		return ctx.codec_threads() >= 1;
+	});
+	engine.wait();
+
+	REQUIRE(options.rfind("g=25:threads=", 0) == 0);
+	REQUIRE(engine.succeeded() == 1);
+}
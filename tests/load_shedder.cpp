@@ -0,0 +1,151 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "load_shedder.hpp"
+#include <deque>
+
+#define NB_FRAMES 600
+
+static const std::string clip = "/tmp/load_shedder.mkv";
+
+static std::vector<av::packet> demux(av::input &in)
+{
+	std::vector<av::packet> packets;
+	av::packet p;
+
+	while (in >> p)
+		packets.push_back(p);
+
+	return packets;
+}
+
+/*
+ * A live source producing one packet per tick and a consumer slowed down
+ * to 4 ticks per decoded packet for the first half of the stream, on a
+ * simulated clock so that the run does not depend on the machine.
+ */
+TEST_CASE("A slow consumer escalates then recovers", "[load_shedder]")
+{
+	const double tick = 0.01;
+
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:bf=2"));
+
+	av::input in;
+	REQUIRE(in.open(clip));
+
+	// no frame threads, their delay would blur the level changes
+	av::decoder dec = in.get(0, "", "threads=1");
+	REQUIRE(!!dec);
+
+	auto packets = demux(in);
+	REQUIRE(packets.size() == NB_FRAMES);
+
+	av::load_shedder shedder(dec, {25, 1});
+	std::deque<av::packet> queue;
+	av::shed_level highest = av::shed_level::none;
+	size_t next = 0, max_depth = 0;
+	double busy_until = 0;
+	int nb_frames = 0;
+	av::frame f;
+
+	for (int now = 0; next < packets.size() || !queue.empty(); now++) {
+		bool slow = next < packets.size() / 2;
+
+		if (next < packets.size())
+			queue.push_back(packets[next++]);
+
+		max_depth = std::max(max_depth, queue.size());
+
+		while (!queue.empty() && busy_until <= now) {
+			av::packet p = queue.front();
+			double cost = slow ? 4 : 0.2;
+
+			queue.pop_front();
+
+			if (!shedder.admit(p, queue.size()))
+				continue;
+
+			REQUIRE(dec << p);
+			while (dec >> f)
+				nb_frames++;
+
+			busy_until = now + cost;
+			shedder.decoded(cost * tick);
+		}
+
+		highest = std::max(highest, shedder.level());
+	}
+
+	REQUIRE(highest == av::shed_level::gop);
+	REQUIRE(shedder.dropped() > 0);
+	REQUIRE(nb_frames < NB_FRAMES);
+
+	// without shedding the backlog would reach 3/4 of the slow half
+	REQUIRE(max_depth < NB_FRAMES / 4);
+
+	REQUIRE(shedder.level() == av::shed_level::none);
+}
+
+TEST_CASE("Slow decoding alone escalates", "[load_shedder]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:bf=2"));
+
+	av::input in;
+	REQUIRE(in.open(clip));
+
+	av::decoder dec = in.get(0, "", "threads=1");
+	REQUIRE(!!dec);
+
+	auto packets = demux(in);
+	av::load_shedder shedder(dec, {25, 1});
+	av::shed_level highest = av::shed_level::none;
+	av::frame f;
+	int non_intra = 0;
+
+	// twice the frame interval per packet, with an empty queue
+	for (size_t i = 0; i < packets.size() / 2; i++) {
+		if (!shedder.admit(packets[i], 0))
+			continue;
+
+		REQUIRE(dec << packets[i]);
+		while (dec >> f)
+			if (shedder.level() >= av::shed_level::keyframes &&
+			    f.f->pict_type != AV_PICTURE_TYPE_I)
+				non_intra++;
+
+		shedder.decoded(0.08);
+		highest = std::max(highest, shedder.level());
+	}
+
+	// dropped GOPs cost nothing, it then oscillates with keyframes only
+	REQUIRE(highest == av::shed_level::gop);
+	REQUIRE(shedder.level() >= av::shed_level::keyframes);
+
+	// a few frames decoded before the switch may still come out
+	REQUIRE(non_intra <= 4);
+
+	// the empty packet flushing the decoder is never shed
+	REQUIRE(shedder.admit(av::packet(), 0));
+
+	for (size_t i = packets.size() / 2; i < packets.size(); i++) {
+		av::shed_level before = shedder.level();
+		bool admitted = shedder.admit(packets[i], 0);
+
+		// decoding more only starts on a keyframe
+		if (shedder.level() < before)
+			REQUIRE(packets[i].is_keyframe());
+
+		if (!admitted)
+			continue;
+
+		dec << packets[i];
+		while (dec >> f)
+			;
+
+		shedder.decoded(0.001);
+	}
+
+	REQUIRE(shedder.level() == av::shed_level::none);
+}
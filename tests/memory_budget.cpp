@@ -0,0 +1,114 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "memory_budget.hpp"
+#include "queue.hpp"
+#include <thread>
+
+#define NB_FRAMES 100
+
+static const std::string clip = "/tmp/memory_budget_test.mkv";
+
+TEST_CASE("Sources block on a slow consumer", "[memory_budget]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:sc_threshold=0"));
+
+	size_t process_used = av::memory_budget::process().used();
+	size_t limit = 32 << 10, largest = 0;
+	av::memory_budget budget(limit, av::overflow::block);
+	av::bounded_queue<av::packet> queue(NB_FRAMES);
+	av::input in;
+	int received = 0;
+
+	REQUIRE(in.open(clip));
+	in.set_budget(&budget);
+
+	std::thread producer([&]() {
+		av::packet p;
+
+		while (in >> p) {
+			largest = std::max<size_t>(largest, p.size());
+			queue.push(p);
+		}
+		queue.close();
+	});
+
+	av::packet p;
+
+	while (queue.pop(p)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		received++;
+	}
+	producer.join();
+
+	REQUIRE(received == NB_FRAMES);
+	REQUIRE(budget.peak() > 0);
+	REQUIRE(budget.peak() <= std::max(limit, largest));
+	REQUIRE(budget.shed() == 0);
+
+	p = av::packet();
+	REQUIRE(budget.used() == 0);
+	REQUIRE(av::memory_budget::process().used() == process_used);
+}
+
+TEST_CASE("Sources shed past the budget", "[memory_budget]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:sc_threshold=0"));
+
+	av::input in;
+	av::packet p;
+
+	REQUIRE(in.open(clip));
+
+	SECTION("packets restart on a keyframe")
+	{
+		av::memory_budget budget(32 << 10, av::overflow::shed);
+		std::vector<av::packet> held;
+		size_t shed = 0;
+
+		in.set_budget(&budget);
+
+		while (in >> p) {
+			if (held.empty() || budget.shed() != shed)
+				REQUIRE(p.is_keyframe());
+
+			shed = budget.shed();
+			held.push_back(p);
+		}
+
+		REQUIRE(budget.shed() > 0);
+		REQUIRE(held.size() < NB_FRAMES);
+
+		held.clear();
+		p = av::packet();
+		REQUIRE(budget.used() == 0);
+	}
+
+	SECTION("frames")
+	{
+		av::decoder dec = in.get(0);
+		av::memory_budget budget(2 * 320 * 240 * 3 / 2 + 4096,
+					 av::overflow::shed);
+		std::vector<av::frame> held;
+		av::frame f;
+
+		REQUIRE(!!dec);
+		dec.set_budget(&budget);
+
+		while (in >> p) {
+			dec << p;
+			while (dec >> f)
+				held.push_back(f);
+		}
+
+		REQUIRE(!held.empty());
+		REQUIRE(held.size() <= 2);
+		REQUIRE(budget.shed() > 0);
+
+		held.clear();
+		f = av::frame();
+		REQUIRE(budget.used() == 0);
+	}
+}
@@ -0,0 +1,175 @@
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "metrics.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#define NB_FRAMES 25
+
+static const std::string reference = "/tmp/metrics_reference.mkv";
+static const std::string distorted = "/tmp/metrics_distorted.mkv";
+
+static av::frame constant_frame(int value)
+{
+	av::frame f;
+
+	f.f->format = AV_PIX_FMT_YUV420P;
+	f.f->width = 64;
+	f.f->height = 48;
+	av_frame_get_buffer(f.f, 0);
+
+	for (int p = 0; p < 3; p++)
+		for (int y = 0; y < (p ? 24 : 48); y++)
+			memset(f.f->data[p] + y * f.f->linesize[p], value,
+			       p ? 32 : 64);
+
+	return f;
+}
+
+/*
+ * run the ffmpeg filters, false when the ffmpeg program isn't there
+ */
+static bool ffmpeg_metrics(double psnr[4], double ssim[4])
+{
+	std::string cmd = "ffmpeg -nostdin -hide_banner -i " + distorted +
+			  " -i " + reference +
+			  " -lavfi \"[0:v]split[a][b];[1:v]split[c][d];"
+			  "[a][c]psnr;[b][d]ssim\" -f null - 2>&1";
+	bool has_psnr = false, has_ssim = false;
+	char line[1024];
+	FILE *f;
+
+	if (system("ffmpeg -version > /dev/null 2>&1") != 0)
+		return false;
+
+	f = popen(cmd.c_str(), "r");
+	if (!f)
+		return false;
+
+	while (fgets(line, sizeof(line), f)) {
+		const char *p;
+
+		if ((p = strstr(line, "PSNR y:")))
+			has_psnr = sscanf(p,
+					  "PSNR y:%lf u:%lf v:%lf average:%lf",
+					  &psnr[0], &psnr[1], &psnr[2],
+					  &psnr[3]) == 4;
+
+		if ((p = strstr(line, "SSIM Y:")))
+			has_ssim = sscanf(p,
+					  "SSIM Y:%lf %*s U:%lf %*s V:%lf %*s "
+					  "All:%lf",
+					  &ssim[0], &ssim[1], &ssim[2],
+					  &ssim[3]) == 4;
+	}
+	pclose(f);
+
+	return has_psnr && has_ssim;
+}
+
+TEST_CASE("PSNR and SSIM of known frames", "[metrics]")
+{
+	av::frame a = constant_frame(100), b = constant_frame(110);
+
+	auto psnr = av::metrics::psnr(b, a);
+
+	REQUIRE(psnr.nb_planes == 3);
+	for (int i = 0; i < 3; i++)
+		REQUIRE(psnr.planes[i] ==
+			Catch::Approx(10 * std::log10(255.0 * 255 / 100)));
+
+	auto same = av::metrics::psnr(a, a);
+	REQUIRE(std::isinf(same.all));
+
+	auto ssim = av::metrics::ssim(a, a);
+	REQUIRE(ssim.all == Catch::Approx(1.0));
+
+	av::frame small = constant_frame(0);
+	small.f->width = 32;
+	REQUIRE(av::metrics::psnr(small, a).nb_planes == 0);
+
+	// semi-planar chroma is refused, not read from a missing plane
+	av::frame nv12;
+	nv12.f->format = AV_PIX_FMT_NV12;
+	nv12.f->width = 64;
+	nv12.f->height = 48;
+	REQUIRE(av_frame_get_buffer(nv12.f, 0) == 0);
+	REQUIRE(av::metrics::psnr(nv12, nv12).nb_planes == 0);
+	REQUIRE(av::metrics::ssim(nv12, nv12).nb_planes == 0);
+}
+
+TEST_CASE("SIMD and scalar kernels agree", "[metrics]")
+{
+	av::frame a, b;
+
+	generate_frame(a.f, 0, 333, 201);
+	generate_frame(b.f, 7, 333, 201);
+
+	av::metrics::set_simd(false);
+	auto psnr = av::metrics::psnr(b, a);
+	auto ssim = av::metrics::ssim(b, a);
+
+	av::metrics::set_simd(true);
+	auto simd_psnr = av::metrics::psnr(b, a);
+	auto simd_ssim = av::metrics::ssim(b, a);
+
+	for (int i = 0; i < 3; i++) {
+		REQUIRE(psnr.planes[i] == simd_psnr.planes[i]);
+		REQUIRE(ssim.planes[i] == simd_ssim.planes[i]);
+	}
+}
+
+TEST_CASE("Streaming metrics match libavfilter", "[metrics]")
+{
+	REQUIRE(generate_clip(reference, "ffv1", 320, 240, NB_FRAMES));
+	REQUIRE(generate_clip(distorted, "libx264", 320, 240, NB_FRAMES,
+			      "crf=40"));
+
+	av::input ref_in, dist_in;
+	av::metrics::accumulator acc;
+	av::packet p;
+	av::frame ref_f, dist_f;
+
+	REQUIRE(ref_in.open(reference));
+	REQUIRE(dist_in.open(distorted));
+
+	av::decoder ref_dec = ref_in.get(0);
+	av::decoder dist_dec = dist_in.get(0);
+
+	// both decoders output one frame per packet once flushed
+	auto next = [&p](av::input &in, av::decoder &dec, av::frame &f) {
+		while (!(dec >> f)) {
+			if (in >> p)
+				dec << p;
+			else if (!dec.flush() && !(dec >> f))
+				return false;
+		}
+		return true;
+	};
+
+	while (next(ref_in, ref_dec, ref_f) && next(dist_in, dist_dec, dist_f))
+		REQUIRE(acc.add(dist_f, ref_f));
+
+	REQUIRE(acc.frames() == NB_FRAMES);
+
+	double psnr[4], ssim[4];
+
+	if (!ffmpeg_metrics(psnr, ssim))
+		return;
+
+	auto our_psnr = acc.psnr();
+	auto our_ssim = acc.ssim();
+
+	// the filters print 2 decimals for PSNR and 6 for SSIM
+	for (int i = 0; i < 3; i++) {
+		REQUIRE(our_psnr.planes[i] ==
+			Catch::Approx(psnr[i]).margin(0.01));
+		REQUIRE(our_ssim.planes[i] ==
+			Catch::Approx(ssim[i]).margin(1e-6));
+	}
+	REQUIRE(our_psnr.all == Catch::Approx(psnr[3]).margin(0.01));
+	REQUIRE(our_ssim.all == Catch::Approx(ssim[3]).margin(1e-6));
+}
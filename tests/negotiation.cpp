@@ -0,0 +1,111 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "negotiation.hpp"
+
+static const std::string clip = "/tmp/negotiation.mkv";
+
+TEST_CASE("Decoder formats are kept when the encoder takes them",
+	  "[negotiation]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, 10));
+
+	av::input in;
+	REQUIRE(in.open(clip));
+
+	av::decoder dec = in.get(0);
+	REQUIRE(!!dec);
+
+	REQUIRE(av::negotiate(dec, "libx264") == "pixel_format=yuv420p");
+	REQUIRE(av::negotiate(dec, "ffv1") == "pixel_format=yuv420p");
+
+	// png has no yuv format
+	const AVCodec *png = avcodec_find_encoder_by_name("png");
+	REQUIRE(png);
+
+	AVPixelFormat format = av::negotiate(AV_PIX_FMT_YUV420P, png);
+	bool listed = false;
+
+	for (const AVPixelFormat *p = png->pix_fmts; *p != AV_PIX_FMT_NONE; p++)
+		listed |= *p == format;
+
+	REQUIRE(listed);
+
+	SECTION("sample formats")
+	{
+		const AVCodec *aac = avcodec_find_encoder_by_name("aac");
+		REQUIRE(aac);
+
+		// only planar float: the planar version of the same type
+		REQUIRE(av::negotiate(AV_SAMPLE_FMT_FLT, aac) ==
+			AV_SAMPLE_FMT_FLTP);
+		REQUIRE(av::negotiate(AV_SAMPLE_FMT_FLTP, aac) ==
+			AV_SAMPLE_FMT_FLTP);
+		REQUIRE(av::negotiate(AV_SAMPLE_FMT_S16, aac) ==
+			AV_SAMPLE_FMT_FLTP);
+	}
+}
+
+TEST_CASE("Frames are converted only when needed", "[negotiation]")
+{
+	av::output out;
+
+	REQUIRE(out.open("/tmp/negotiation_out.mkv"));
+
+	SECTION("video")
+	{
+		av::encoder enc = out.add_stream(
+		    "libx264",
+		    "video_size=320x240:pixel_format=yuv420p:time_base=1/25");
+		REQUIRE(!!enc);
+
+		av::converter converter(enc);
+		av::frame f, big;
+
+		generate_frame(f.f, 0, 320, 240);
+		generate_frame(big.f, 1, 640, 480);
+
+		// same format: the very same buffers
+		av::frame same = converter.convert(f);
+		REQUIRE(same.f->data[0] == f.f->data[0]);
+
+		// size change mid-stream
+		av::frame scaled = converter.convert(big);
+		REQUIRE(scaled.f->width == 320);
+		REQUIRE(scaled.f->height == 240);
+		REQUIRE(scaled.f->format == AV_PIX_FMT_YUV420P);
+		REQUIRE(scaled.f->pts == 1);
+
+		REQUIRE(converter.convert(f).f->data[0] == f.f->data[0]);
+
+		REQUIRE(converter.passed() == 2);
+		REQUIRE(converter.converted() == 1);
+	}
+
+	SECTION("audio")
+	{
+		av::encoder enc = out.add_stream(
+		    "aac", "time_base=1/48000:ar=48000:ch_layout=stereo:"
+			   "request_sample_fmt=fltp");
+		REQUIRE(!!enc);
+
+		av::converter converter(enc);
+		av::frame f;
+
+		f.f->format = AV_SAMPLE_FMT_S16;
+		f.f->sample_rate = 48000;
+		f.f->nb_samples = 1024;
+		av_channel_layout_default(&f.f->ch_layout, 2);
+		REQUIRE(av_frame_get_buffer(f.f, 0) == 0);
+
+		av::frame resampled = converter.convert(f);
+		REQUIRE(resampled.f->format == AV_SAMPLE_FMT_FLTP);
+		REQUIRE(resampled.f->sample_rate == 48000);
+		REQUIRE(resampled.f->ch_layout.nb_channels == 2);
+		REQUIRE(resampled.f->nb_samples == 1024);
+
+		REQUIRE(converter.converted() == 1);
+		REQUIRE(converter.convert(resampled).f->data[0] ==
+			resampled.f->data[0]);
+	}
+}
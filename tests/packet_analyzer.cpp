@@ -0,0 +1,51 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "packet_analyzer.hpp"
+
+#define NB_FRAMES 100
+
+static const std::string clip = "/tmp/packet_analyzer.mkv";
+
+TEST_CASE("Frames are classified without decoding", "[packet_analyzer]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:bf=2"));
+
+	av::packet_analyzer analyzer;
+	av::input in;
+	av::packet p;
+	uint64_t bytes = 0;
+
+	REQUIRE(in.open(clip));
+	REQUIRE(analyzer.open(in));
+
+	while (in >> p) {
+		REQUIRE(analyzer << p);
+		bytes += p.size();
+	}
+
+	const av::packet_stats *stats = analyzer.stats(0);
+	REQUIRE(stats);
+	REQUIRE(!analyzer.stats(1));
+
+	REQUIRE(stats->packets == NB_FRAMES);
+	REQUIRE(stats->bytes == bytes);
+
+	auto &types = stats->types;
+	REQUIRE(types[(int)av::frame_type::unknown] == 0);
+	REQUIRE(types[(int)av::frame_type::i] >= 4);
+	REQUIRE(types[(int)av::frame_type::p] > 0);
+	REQUIRE(types[(int)av::frame_type::b] > 0);
+
+	// scene cuts may add keyframes, never more than 25 frames apart
+	REQUIRE(stats->keyframes >= 4);
+	REQUIRE(stats->gop > 0);
+	REQUIRE(stats->gop <= 25);
+	REQUIRE(stats->mean_gop <= 25);
+	REQUIRE(stats->keyframe_interval > 0);
+	REQUIRE(stats->keyframe_interval <= 1.0);
+
+	REQUIRE(stats->min_size <= stats->max_size);
+	REQUIRE(stats->bitrate > 0);
+}
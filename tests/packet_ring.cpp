@@ -0,0 +1,109 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "packet_ring.hpp"
+
+#define NB_FRAMES 100
+
+static const std::string clip = "/tmp/packet_ring_test.mkv";
+
+TEST_CASE("Ring keeps whole GOPs of the last seconds", "[packet_ring]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:sc_threshold=0"));
+
+	av::input in;
+	av::packet p;
+
+	REQUIRE(in.open(clip));
+
+	SECTION("duration bound")
+	{
+		av::packet_ring ring(in, 1.0, 64 << 20);
+
+		while (in >> p)
+			ring.push(p);
+
+		// GOPs start at 0, 1, 2 and 3s, the last frame is at 3.96s
+		REQUIRE(ring.gops() == 2);
+		REQUIRE(ring.duration() >= 1.0);
+	}
+
+	SECTION("byte bound")
+	{
+		size_t total = 0;
+
+		while (in >> p)
+			total += p.size();
+
+		REQUIRE(in.open(clip));
+
+		av::packet_ring ring(in, 60.0, total / 2);
+
+		while (in >> p) {
+			ring.push(p);
+			REQUIRE(ring.bytes() <= total / 2);
+		}
+
+		REQUIRE(ring.gops() >= 1);
+		REQUIRE(ring.gops() < 4);
+	}
+
+	SECTION("byte bound below a GOP")
+	{
+		size_t total = 0;
+
+		while (in >> p)
+			total += p.size();
+
+		REQUIRE(in.open(clip));
+
+		// a GOP is about a quarter of the clip
+		av::packet_ring ring(in, 60.0, total / 8);
+
+		while (in >> p) {
+			ring.push(p);
+			REQUIRE(ring.bytes() <= total / 8);
+			REQUIRE(ring.gops() <= 1);
+		}
+	}
+}
+
+TEST_CASE("Ring drains to an output from a keyframe", "[packet_ring]")
+{
+	std::string drained = "/tmp/packet_ring_drained.mkv";
+	av::input in;
+	av::output out;
+	av::packet p;
+
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:sc_threshold=0"));
+	REQUIRE(in.open(clip));
+
+	av::packet_ring ring(in, 1.0, 64 << 20);
+
+	while (in >> p)
+		ring.push(p);
+
+	REQUIRE(out.open(drained));
+	REQUIRE(out.add_stream(in, 0) == 0);
+	REQUIRE(ring.drain(out));
+	REQUIRE(ring.gops() == 0);
+
+	out = av::output();
+
+	av::input check;
+	int count = 0;
+
+	REQUIRE(check.open(drained));
+
+	while (check >> p) {
+		if (count++ == 0) {
+			REQUIRE(p.is_keyframe());
+			// the first kept keyframe was at 2s
+			REQUIRE(p.pts() < 1000);
+		}
+	}
+
+	REQUIRE(count == 50);
+}
@@ -0,0 +1,75 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "parallel.hpp"
+
+TEST_CASE("Rows are split over the pool", "[parallel]")
+{
+	av::thread_pool pool(4);
+	av::frame f;
+
+	generate_frame(f.f, 0, 641, 361);
+
+	SECTION("every row once, chroma subsampled")
+	{
+		for (int plane = 0; plane < 3; plane++) {
+			int width = plane ? 321 : 641;
+			int height = plane ? 181 : 361;
+			std::vector<std::atomic<int>> visits(height);
+			std::atomic<int> bad_sizes(0);
+
+			// no REQUIRE in the kernel, it runs on the pool threads
+			REQUIRE(av::parallel_for_rows(
+			    f, plane,
+			    [&](std::span<uint8_t> row, int y) {
+				    if (row.size() != (size_t)width)
+					    bad_sizes++;
+				    visits[y]++;
+			    },
+			    pool));
+
+			REQUIRE(bad_sizes == 0);
+			for (auto &v : visits)
+				REQUIRE(v == 1);
+		}
+	}
+
+	SECTION("shared frames are copied before writing")
+	{
+		av::frame shared = f;
+
+		REQUIRE(av::parallel_for_rows(
+		    f, 0, [](std::span<uint8_t> row, int) { row[0] = 1; },
+		    pool));
+
+		REQUIRE(f.f->data[0] != shared.f->data[0]);
+		REQUIRE(shared.f->data[0][0] == 0);
+		REQUIRE(f.f->data[0][0] == 1);
+	}
+
+	SECTION("read only")
+	{
+		const av::frame &ro = f;
+		std::atomic<uint64_t> sum(0);
+		uint64_t expected = 0;
+
+		for (int y = 0; y < 361; y++)
+			for (int x = 0; x < 641; x++)
+				expected += (uint8_t)(x + y);
+
+		REQUIRE(av::parallel_for_rows(
+		    ro, 0,
+		    [&](std::span<const uint8_t> row, int) {
+			    uint64_t s = 0;
+
+			    for (auto p : row)
+				    s += p;
+			    sum += s;
+		    },
+		    pool));
+
+		REQUIRE(sum == expected);
+	}
+
+	REQUIRE(!av::parallel_for_rows(f, 3, [](std::span<uint8_t>, int) {}));
+}
@@ -0,0 +1,84 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "hash.hpp"
+#include "parallel_encoder.hpp"
+
+#define NB_FRAMES 60
+
+static const std::string clip = "/tmp/parallel_encoder.mkv";
+
+TEST_CASE("Intra frames are encoded in parallel and in order",
+	  "[parallel_encoder]")
+{
+	std::vector<uint64_t> expected;
+
+	{
+		av::parallel_encoder enc;
+		av::output out;
+
+		REQUIRE(out.open(clip));
+		// a gop size given here must not make the instances inter
+		REQUIRE(enc.open(out, "ffv1",
+				 "video_size=320x240:pixel_format=yuv420p:"
+				 "time_base=1/25:g=12",
+				 4));
+		REQUIRE(enc.size() == 4);
+
+		for (int i = 0; i < NB_FRAMES; i++) {
+			av::frame f;
+
+			generate_frame(f.f, i, 320, 240);
+			expected.push_back(av::hash(f).all);
+			REQUIRE(enc << f);
+		}
+
+		REQUIRE(enc.flush());
+	}
+
+	av::input in;
+	av::packet p;
+	av::frame f;
+	int64_t last_pts = AV_NOPTS_VALUE;
+	int nb_packets = 0, nb_frames = 0;
+
+	REQUIRE(in.open(clip));
+	av::decoder dec = in.get(0);
+	REQUIRE(!!dec);
+
+	// lossless: every decoded frame is the pushed one
+	auto drain = [&]() {
+		while (dec >> f) {
+			REQUIRE(nb_frames < NB_FRAMES);
+			REQUIRE(av::hash(f).all == expected[nb_frames]);
+			nb_frames++;
+		}
+	};
+
+	while (in >> p) {
+		REQUIRE(p.pts() > last_pts);
+		REQUIRE(p.is_keyframe());
+		last_pts = p.pts();
+		nb_packets++;
+
+		REQUIRE(dec << p);
+		drain();
+	}
+
+	dec.flush();
+	drain();
+
+	REQUIRE(nb_packets == NB_FRAMES);
+	REQUIRE(nb_frames == NB_FRAMES);
+}
+
+TEST_CASE("Inter codecs are refused", "[parallel_encoder]")
+{
+	av::parallel_encoder enc;
+	av::output out;
+
+	REQUIRE(out.open("/tmp/parallel_encoder_x264.mkv"));
+	REQUIRE(!enc.open(out, "libx264",
+			  "video_size=320x240:pixel_format=yuv420p:"
+			  "time_base=1/25"));
+}
@@ -0,0 +1,112 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "hash.hpp"
+#include <fstream>
+
+#define NB_FRAMES 250
+
+static const std::string clip = "/tmp/probe_test.ts";
+static const std::string other = "/tmp/probe_test_other.mkv";
+
+// bytes read by the process so far, from /proc/self/io
+static uint64_t bytes_read()
+{
+	std::ifstream io("/proc/self/io");
+	std::string key;
+	uint64_t value;
+
+	while (io >> key >> value)
+		if (key == "rchar:")
+			return value;
+
+	return 0;
+}
+
+struct open_result {
+	uint64_t bytes;
+	int width, height;
+	std::vector<uint64_t> hashes;
+};
+
+template <typename F> static open_result read_clip(F open)
+{
+	open_result r = {0, 0, 0, {}};
+	av::input in;
+	av::packet p;
+	av::frame f;
+
+	uint64_t before = bytes_read();
+	REQUIRE(open(in));
+	r.bytes = bytes_read() - before;
+
+	av::decoder dec = in.get(0);
+	REQUIRE(!!dec);
+
+	while (in >> p) {
+		REQUIRE(dec << p);
+		while (dec >> f) {
+			r.width = f.f->width;
+			r.height = f.f->height;
+			r.hashes.push_back(av::hash(f).all);
+		}
+	}
+
+	dec.flush();
+	while (dec >> f)
+		r.hashes.push_back(av::hash(f).all);
+
+	return r;
+}
+
+/*
+ * a lossless clip of several MB: the default probing reads seconds of it,
+ * the minimal one a single packet
+ */
+TEST_CASE("Minimal probing and cached stream infos", "[probe]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:bf=2:qp=0"));
+
+	auto full = read_clip([](av::input &in) { return in.open(clip); });
+	REQUIRE(full.hashes.size() == NB_FRAMES);
+
+	auto minimal = read_clip([](av::input &in) {
+		return in.open(clip, av::probe::minimal);
+	});
+	REQUIRE(minimal.bytes < full.bytes / 4);
+
+	av::stream_info info;
+	{
+		av::input in;
+
+		REQUIRE(in.open(clip));
+		info = in.get_stream_info();
+	}
+
+	SECTION("cached infos skip the probing")
+	{
+		auto cached = read_clip(
+		    [&](av::input &in) { return in.open(clip, info); });
+
+		REQUIRE(cached.bytes < full.bytes / 4);
+		REQUIRE(cached.width == 320);
+		REQUIRE(cached.height == 240);
+		REQUIRE(cached.hashes == full.hashes);
+	}
+
+	SECTION("stale infos probe again")
+	{
+		REQUIRE(generate_clip(other, "ffv1", 160, 120, 10));
+
+		av::input first;
+		REQUIRE(first.open(other));
+		av::stream_info stale = first.get_stream_info();
+
+		auto probed = read_clip(
+		    [&](av::input &in) { return in.open(clip, stale); });
+
+		REQUIRE(probed.width == 320);
+		REQUIRE(probed.hashes == full.hashes);
+	}
+}
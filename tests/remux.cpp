@@ -0,0 +1,190 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "hash.hpp"
+#include <cmath>
+
+#define NB_FRAMES 100
+
+static const std::string clip = "/tmp/remux_test_in.mkv";
+static const std::string remuxed = "/tmp/remux_test_out.mkv";
+
+struct packet_info {
+	double pts, dts;
+	bool key;
+};
+
+/*
+ * the packets of the first stream of uri, with their timestamps in seconds,
+ * and the hashes of the frames they decode to
+ */
+static void read_clip(const std::string &uri, std::vector<packet_info> &packets,
+		      std::vector<uint64_t> &hashes)
+{
+	av::input in;
+	av::packet p;
+	av::frame f;
+
+	REQUIRE(in.open(uri));
+
+	AVRational tb = in.time_base(0);
+	av::decoder dec = in.get(0);
+	REQUIRE(!!dec);
+
+	while (in >> p) {
+		packets.push_back({p.pts() * av_q2d(tb), p.dts() * av_q2d(tb),
+				   p.is_keyframe()});
+
+		REQUIRE(dec << p);
+		while (dec >> f)
+			hashes.push_back(av::hash(f).all);
+	}
+
+	dec.flush();
+	while (dec >> f)
+		hashes.push_back(av::hash(f).all);
+}
+
+TEST_CASE("Remux copies every packet with its timestamps", "[remux]")
+{
+	std::vector<packet_info> expected, packets;
+	std::vector<uint64_t> expected_hashes, hashes;
+	av::remux_progress last = {0, 0, 0};
+
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:bf=2"));
+	read_clip(clip, expected, expected_hashes);
+	REQUIRE(expected.size() == NB_FRAMES);
+
+	{
+		av::input in;
+		av::output out;
+
+		REQUIRE(in.open(clip));
+		REQUIRE(out.open(remuxed));
+		REQUIRE(out.add_stream(in, 0) == 0);
+
+		REQUIRE(av::remux(in, out, {0},
+				  [&](const av::remux_progress &progress) {
+					  last = progress;
+					  return true;
+				  }));
+	}
+
+	REQUIRE(last.packets == NB_FRAMES);
+
+	read_clip(remuxed, packets, hashes);
+
+	REQUIRE(packets.size() == expected.size());
+	for (size_t i = 0; i < packets.size(); i++) {
+		REQUIRE(packets[i].pts == expected[i].pts);
+		REQUIRE(packets[i].dts == expected[i].dts);
+		REQUIRE(packets[i].key == expected[i].key);
+	}
+
+	REQUIRE(hashes == expected_hashes);
+}
+
+TEST_CASE("Remux drops unmapped streams", "[remux]")
+{
+	av::input in;
+	av::output out;
+
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES));
+	REQUIRE(in.open(clip));
+	REQUIRE(out.open(remuxed));
+	REQUIRE(out.add_stream(in, 0) == 0);
+
+	// stream 0 dropped: nothing is written
+	av::remux_progress last = {1, 1, 0};
+
+	REQUIRE(av::remux(in, out, {-1},
+			  [&](const av::remux_progress &progress) {
+				  last = progress;
+				  return true;
+			  }));
+	REQUIRE(last.packets == 0);
+}
+
+// an Annex B start code, 3 or 4 bytes long, at offset i
+static bool start_code(const av::packet &p, int i)
+{
+	const uint8_t *d = p.data() + i;
+
+	if (i + 4 > p.size() || d[0] != 0 || d[1] != 0)
+		return false;
+
+	return d[2] == 1 || (d[2] == 0 && d[3] == 1);
+}
+
+static bool has_sps(const av::packet &p)
+{
+	for (int i = 0; i + 4 < p.size(); i++)
+		if (p.data()[i] == 0 && p.data()[i + 1] == 0 &&
+		    p.data()[i + 2] == 1 && (p.data()[i + 3] & 0x1f) == 7)
+			return true;
+
+	return false;
+}
+
+/*
+ * h264 from mkv is length prefixed: h264_mp4toannexb is inserted for
+ * mpegts, whether the packets are rescaled by the output or before
+ */
+TEST_CASE("Remux to mpegts converts h264 to Annex B", "[remux]")
+{
+	static const std::string ts = "/tmp/remux_test_out.ts";
+	std::vector<packet_info> expected;
+	std::vector<uint64_t> expected_hashes, hashes;
+
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:bf=2"));
+	read_clip(clip, expected, expected_hashes);
+
+	{
+		av::input in;
+		av::output out;
+		av::packet p;
+
+		REQUIRE(in.open(clip));
+		REQUIRE(out.open(ts));
+		REQUIRE(out.add_stream(in, 0) == 0);
+
+		SECTION("remux") { REQUIRE(av::remux(in, out)); }
+		SECTION("packet writes")
+		{
+			while (in >> p)
+				REQUIRE(out << p);
+		}
+	}
+
+	av::input in;
+	av::packet p;
+	size_t n = 0;
+	double first_pts = 0;
+
+	REQUIRE(in.open(ts));
+	AVRational tb = in.time_base(0);
+
+	// mpegts starts its timestamps with a delay
+	while (in >> p) {
+		REQUIRE(n < expected.size());
+		REQUIRE(start_code(p, 0));
+		if (p.is_keyframe())
+			REQUIRE(has_sps(p));
+
+		if (n == 0)
+			first_pts = p.pts() * av_q2d(tb) - expected[0].pts;
+
+		double pts = p.pts() * av_q2d(tb) - first_pts;
+		REQUIRE(std::abs(pts - expected[n].pts) < 1e-6);
+		REQUIRE(p.is_keyframe() == expected[n].key);
+		n++;
+	}
+
+	REQUIRE(n == expected.size());
+
+	std::vector<packet_info> packets;
+	read_clip(ts, packets, hashes);
+	REQUIRE(hashes == expected_hashes);
+}
@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "segmenter.hpp"
+#include <filesystem>
+
+#define NB_FRAMES 250
+#define FPS 25
+
+static const std::string clip = "/tmp/segmenter_test.mkv";
+static const std::string pattern = "/tmp/segmenter_test-{:03d}.ts";
+
+static std::string segment_uri(int index)
+{
+	return fmt::format(fmt::runtime(pattern), index);
+}
+
+struct segment_info {
+	int packets;
+	bool starts_on_keyframe;
+};
+
+static segment_info read_segment(int index)
+{
+	segment_info info = {0, false};
+	av::input in;
+	av::packet p;
+
+	if (!in.open(segment_uri(index)))
+		return info;
+
+	while (in >> p) {
+		if (info.packets++ == 0)
+			info.starts_on_keyframe = p.is_keyframe();
+	}
+
+	return info;
+}
+
+/*
+ * keyframes every second and 2.5s segments: each segment but the last is
+ * cut on the first keyframe after 2.5s, i.e. 3s long
+ */
+TEST_CASE("Segments start on keyframes and last the target duration",
+	  "[segmenter]")
+{
+	bool preopen = false;
+	int nb_segments = 0;
+
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES,
+			      "g=25:bf=2:x264-params=scenecut=0"));
+
+	for (int i = 0; i < 8; i++)
+		std::filesystem::remove(segment_uri(i));
+
+	SECTION("pre-opened segments") { preopen = true; }
+	SECTION("segments opened on rotation") { preopen = false; }
+
+	{
+		av::input in;
+		av::segmenter seg;
+		av::packet p;
+
+		REQUIRE(in.open(clip));
+		REQUIRE(seg.open(pattern, 2.5, "mpegts", "", preopen));
+		REQUIRE(seg.add_stream(in, 0) == 0);
+
+		while (in >> p)
+			REQUIRE(seg << p);
+
+		nb_segments = seg.segment() + 1;
+	}
+
+	REQUIRE(nb_segments == 4);
+
+	int total = 0;
+
+	for (int i = 0; i < nb_segments; i++) {
+		auto info = read_segment(i);
+
+		REQUIRE(info.starts_on_keyframe);
+		if (i < nb_segments - 1)
+			REQUIRE(info.packets >= 2.5 * FPS);
+		total += info.packets;
+	}
+
+	REQUIRE(total == NB_FRAMES);
+
+	// the segment opened ahead and never written is gone
+	REQUIRE(!std::filesystem::exists(segment_uri(nb_segments)));
+}
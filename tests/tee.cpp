@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "tee.hpp"
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+
+#define NB_FRAMES 250
+
+static const std::string clip = "/tmp/tee.mkv";
+static const std::string record = "/tmp/tee_record.mkv";
+
+static int count_packets(const std::string &uri)
+{
+	av::input in;
+	av::packet p;
+	int count = 0;
+
+	if (!in.open(uri))
+		return -1;
+
+	while (in >> p)
+		count++;
+
+	return count;
+}
+
+/*
+ * One destination is a file, the other a pipe read 4KiB every 10ms: the
+ * file must get every packet while the pipe lags behind.
+ */
+TEST_CASE("A slow destination doesn't stall the others", "[tee]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 640, 480, NB_FRAMES, "g=25"));
+
+	av::tee_policy policy = av::tee_policy::drop;
+
+	SECTION("drop until keyframe") { policy = av::tee_policy::drop; }
+	SECTION("disconnect") { policy = av::tee_policy::disconnect; }
+
+	int fds[2];
+	REQUIRE(pipe(fds) == 0);
+
+	std::thread reader([&]() {
+		char buf[4096];
+
+		while (read(fds[0], buf, sizeof(buf)) > 0)
+			std::this_thread::sleep_for(
+			    std::chrono::milliseconds(10));
+	});
+
+	{
+		av::input in;
+		av::output file, slow;
+		av::packet p;
+		av::tee tee;
+
+		REQUIRE(in.open(clip));
+		REQUIRE(file.open(record));
+		REQUIRE(slow.open_format(fmt::format("pipe:{}", fds[1]),
+					 "mpegts"));
+		REQUIRE(file.add_stream(in, 0) == 0);
+		REQUIRE(slow.add_stream(in, 0) == 0);
+
+		int a = tee.add_destination(file, av::tee_policy::disconnect,
+					    NB_FRAMES);
+		int b = tee.add_destination(slow, policy, 8);
+
+		while (in >> p)
+			REQUIRE(tee << p);
+
+		tee.close();
+
+		REQUIRE(tee.connected(a));
+		REQUIRE(tee.dropped(a) == 0);
+		REQUIRE(tee.dropped(b) > 0);
+		REQUIRE(tee.connected(b) == (policy == av::tee_policy::drop));
+	}
+
+	close(fds[1]);
+	reader.join();
+	close(fds[0]);
+
+	REQUIRE(count_packets(record) == NB_FRAMES);
+}
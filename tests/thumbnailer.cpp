@@ -0,0 +1,64 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "common.hpp"
+#include "thumbnailer.hpp"
+
+#define NB_FRAMES 100
+
+static const std::string clip = "/tmp/thumbnailer.mkv";
+
+TEST_CASE("Thumbnails are seeked, scaled and encoded", "[thumbnailer]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 640, 480, NB_FRAMES, "g=25"));
+
+	std::string codec;
+	std::vector<uint8_t> magic;
+	bool exact = true;
+
+	SECTION("jpeg")
+	{
+		codec = "mjpeg";
+		magic = {0xff, 0xd8};
+	}
+	SECTION("png")
+	{
+		codec = "png";
+		magic = {0x89, 'P', 'N', 'G'};
+	}
+	SECTION("keyframes only")
+	{
+		codec = "mjpeg";
+		magic = {0xff, 0xd8};
+		exact = false;
+	}
+
+	av::thumbnailer thumbnailer(160, codec, 3);
+
+	thumbnailer.set_exact(exact);
+
+	auto thumbnails = thumbnailer.extract(clip, 8);
+	REQUIRE(thumbnails.size() == 8);
+
+	for (size_t i = 0; i < thumbnails.size(); i++) {
+		auto &t = thumbnails[i];
+
+		REQUIRE(t.data.size() > magic.size());
+		REQUIRE(std::equal(magic.begin(), magic.end(), t.data.begin()));
+
+		if (i > 0)
+			REQUIRE(t.time > thumbnails[i - 1].time);
+	}
+}
+
+TEST_CASE("Targets past the end use the last frame", "[thumbnailer]")
+{
+	REQUIRE(generate_clip(clip, "libx264", 320, 240, NB_FRAMES, "g=25"));
+
+	av::thumbnailer thumbnailer(160, "mjpeg", 1);
+
+	auto thumbnails = thumbnailer.extract(clip, {0, 3.9, 60});
+	REQUIRE(thumbnails.size() == 3);
+
+	for (auto &t : thumbnails)
+		REQUIRE(!t.data.empty());
+}
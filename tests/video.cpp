@@ -1,42 +1,13 @@
 #include <catch2/catch_test_macros.hpp>
 
-#include "ffmpeg.hpp"
+#include "common.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <functional>
+#include <random>
 
 #define NB_FRAMES 100
 
-/*
- * code borrow from ffmpeg documentation/example
- */
-static void generate_frame(AVFrame *f, int index, int width, int height)
-{
-	int x, y;
-
-	if (!av_frame_is_writable(f)) {
-		f->width = width;
-		f->height = height;
-		f->format = AV_PIX_FMT_YUV420P;
-		av_frame_get_buffer(f, 0);
-	}
-
-	av_frame_make_writable(f);
-
-	/* Y */
-	for (y = 0; y < height; y++)
-		for (x = 0; x < width; x++)
-			f->data[0][y * f->linesize[0] + x] = x + y + index * 3;
-
-	/* Cb and Cr */
-	for (y = 0; y < height / 2; y++) {
-		for (x = 0; x < width / 2; x++) {
-			f->data[1][y * f->linesize[1] + x] =
-			    128 + y + index * 2;
-			f->data[2][y * f->linesize[2] + x] = 64 + x + index * 5;
-		}
-	}
-
-	f->pts = index;
-}
-
 TEST_CASE("Encoding video using software encoder", "[encoding][software]")
 {
 	std::string encoder_name;
@@ -203,6 +174,287 @@ TEST_CASE("Software Decoding video", "[decoding][software]")
 	REQUIRE(count == 0);
 }
 
+/*
+ * encode the synthetic frames to uri, every packet goes through check
+ */
+static void encode(const std::string &uri, const std::string &codec,
+		   const std::function<bool(const av::packet &)> &check)
+{
+	av::output out;
+	av::frame f;
+	av::packet p;
+
+	REQUIRE(out.open(uri));
+
+	av::encoder enc = out.add_stream(
+	    codec, "video_size=320x240:pixel_format=yuv420p:time_base=1/25");
+	REQUIRE(!!enc);
+
+	for (int i = 0; i < NB_FRAMES; i++) {
+		generate_frame(f.f, i, 320, 240);
+
+		REQUIRE(enc << f);
+		while (enc >> p) {
+			REQUIRE(check(p));
+			out << p;
+		}
+	}
+
+	enc.flush();
+	while (enc >> p) {
+		REQUIRE(check(p));
+		out << p;
+	}
+}
+
+/*
+ * decode the first stream of uri, every frame goes through check
+ */
+static void decode(const std::string &uri,
+		   const std::function<bool(const av::frame &)> &check)
+{
+	av::input in;
+	av::frame f;
+	av::packet p;
+
+	REQUIRE(in.open(uri));
+
+	av::decoder dec = in.get(0);
+	REQUIRE(!!dec);
+
+	while (in >> p) {
+		REQUIRE(dec << p);
+		while (dec >> f)
+			REQUIRE(check(f));
+	}
+
+	dec.flush();
+	while (dec >> f)
+		REQUIRE(check(f));
+}
+
+TEST_CASE("Deterministic encoding", "[encoding][software][hash]")
+{
+	const std::string uri = "/tmp/test.determinism.mkv";
+	const std::string packets = "/tmp/test.determinism.packets";
+	const std::string frames = "/tmp/test.determinism.frames";
+	std::string encoder_name;
+
+	SECTION("h264 encoding") { encoder_name = "libx264"; }
+	SECTION("ffv1 encoding") { encoder_name = "ffv1"; }
+
+	// first run: the golden checksums
+	{
+		av::framehash_writer writer;
+
+		REQUIRE(writer.open(packets));
+		encode(uri, encoder_name,
+		       [&](const av::packet &p) { return writer << p; });
+	}
+	{
+		av::framehash_writer writer;
+
+		REQUIRE(writer.open(frames));
+		decode(uri, [&](const av::frame &f) {
+			return writer.write(0, f);
+		});
+	}
+
+	// second run: checked against them
+	{
+		av::framehash_checker checker;
+
+		REQUIRE(checker.open(packets));
+		encode(uri, encoder_name,
+		       [&](const av::packet &p) { return checker << p; });
+		REQUIRE(checker.finish());
+	}
+	{
+		av::framehash_checker checker;
+
+		REQUIRE(checker.open(frames));
+		decode(uri, [&](const av::frame &f) {
+			return checker.check(0, f);
+		});
+		REQUIRE(checker.finish());
+	}
+}
+
+/*
+ * rate control changes are taken by libx264 without reopening it, keyframes
+ * are forced on the next frame or every g frames
+ */
+TEST_CASE("Runtime encoder reconfiguration", "[encoding][software]")
+{
+	std::vector<int64_t> keyframes;
+	av::output out, other_out;
+	av::frame f;
+	av::packet p;
+
+	REQUIRE(other_out.open("/tmp/test.reconfigure.mkv"));
+
+	av::encoder other = other_out.add_stream(
+	    "mpeg4", "video_size=320x240:pixel_format=yuv420p:time_base=1/25");
+	REQUIRE(!!other);
+	REQUIRE_FALSE(other.reconfigure("b=1M"));
+	REQUIRE(other.reconfigure("keyframe=1"));
+
+	REQUIRE(out.open("/tmp/test.reconfigure.ts"));
+
+	av::encoder enc = out.add_stream(
+	    "libx264", "video_size=320x240:pixel_format=yuv420p:time_base=1/25:"
+		       "g=250:b=1M:maxrate=1M:bufsize=1M:"
+		       "x264-params=scenecut=0");
+	REQUIRE(!!enc);
+
+	REQUIRE(enc.reconfigure("b=500k:maxrate=500k:bufsize=500k"));
+	REQUIRE_FALSE(enc.reconfigure("crf=20"));
+	REQUIRE_FALSE(enc.reconfigure("preset=slow"));
+	REQUIRE_FALSE(enc.reconfigure("g=500"));
+	REQUIRE_FALSE(enc.reconfigure("b=2M:profile=high"));
+
+	auto drain = [&]() {
+		while (enc >> p) {
+			if (p.is_keyframe())
+				keyframes.push_back(p.pts());
+			out << p;
+		}
+	};
+
+	for (int i = 0; i < NB_FRAMES; i++) {
+		generate_frame(f.f, i, 320, 240);
+
+		if (i == 30)
+			REQUIRE(enc.reconfigure("keyframe=1"));
+		if (i == 60)
+			REQUIRE(enc.reconfigure("g=20"));
+
+		REQUIRE(enc << f);
+		drain();
+	}
+
+	enc.flush();
+	drain();
+
+	std::sort(keyframes.begin(), keyframes.end());
+	REQUIRE(keyframes == std::vector<int64_t>{0, 30, 80});
+}
+
+// frames of noise, which use all the bitrate they are given
+static void noise_frame(AVFrame *f, int index)
+{
+	std::minstd_rand rand(index + 1);
+
+	av_frame_make_writable(f);
+
+	for (int p = 0; p < 3; p++) {
+		int width = p ? f->width / 2 : f->width;
+		int height = p ? f->height / 2 : f->height;
+
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				f->data[p][y * f->linesize[p] + x] = rand();
+	}
+}
+
+/*
+ * the same 50 frames before and after lowering the bitrate, the ones after
+ * the VBV settled are compared
+ */
+TEST_CASE("Runtime bitrate change", "[encoding][software]")
+{
+	std::vector<int> sizes;
+	av::output out;
+	av::frame f;
+	av::packet p;
+
+	REQUIRE(out.open("/tmp/test.bitrate.ts"));
+
+	av::encoder enc = out.add_stream(
+	    "libx264", "video_size=320x240:pixel_format=yuv420p:time_base=1/25:"
+		       "b=1M:maxrate=1M:bufsize=1M:tune=zerolatency");
+	REQUIRE(!!enc);
+
+	f = enc.get_empty_frame();
+
+	for (int i = 0; i < 2 * 50; i++) {
+		if (i == 50)
+			REQUIRE(enc.reconfigure("b=250k:maxrate=250k:"
+						"bufsize=250k"));
+
+		noise_frame(f.f, i % 50);
+		f.f->pts = i;
+
+		REQUIRE(enc << f);
+		while (enc >> p) {
+			sizes.push_back(p.size());
+			out << p;
+		}
+	}
+
+	enc.flush();
+	while (enc >> p)
+		sizes.push_back(p.size());
+
+	REQUIRE(sizes.size() == 2 * 50);
+
+	auto bytes = [&](int first) {
+		int total = 0;
+
+		for (int i = first; i < first + 20; i++)
+			total += sizes[i];
+		return total;
+	};
+
+	REQUIRE(bytes(80) < bytes(30) / 2);
+}
+
+/*
+ * the keyframes x264 inserts every 25 frames count for the shorter g set
+ * at runtime: no forced keyframe a few frames after them
+ */
+TEST_CASE("Encoder keyframes restart the runtime GOP", "[encoding][software]")
+{
+	std::vector<int64_t> keyframes;
+	av::output out;
+	av::frame f;
+	av::packet p;
+
+	REQUIRE(out.open("/tmp/test.gop.ts"));
+
+	av::encoder enc = out.add_stream(
+	    "libx264", "video_size=320x240:pixel_format=yuv420p:time_base=1/25:"
+		       "g=25:x264-params=scenecut=0:tune=zerolatency");
+	REQUIRE(!!enc);
+
+	auto drain = [&]() {
+		while (enc >> p) {
+			if (p.is_keyframe())
+				keyframes.push_back(p.pts());
+			out << p;
+		}
+	};
+
+	for (int i = 0; i < NB_FRAMES; i++) {
+		generate_frame(f.f, i, 320, 240);
+
+		if (i == 10)
+			REQUIRE(enc.reconfigure("g=20"));
+
+		REQUIRE(enc << f);
+		drain();
+	}
+
+	enc.flush();
+	drain();
+
+	std::sort(keyframes.begin(), keyframes.end());
+	REQUIRE(keyframes.size() >= 4);
+	REQUIRE(keyframes[1] == 25);
+	for (size_t i = 1; i < keyframes.size(); i++)
+		REQUIRE(keyframes[i] - keyframes[i - 1] >= 20);
+}
+
 TEST_CASE("Metadata handling", "[metadata]")
 {
 	std::string metadata = "service_name=foo:service_provider=bar";